@@ -1,5 +1,6 @@
 #pragma once
 #include "Include.h"
+#include "Butcher.h"
 
 /// <summary>
 /// Beason's Runge-Kutta integrator with some modifications.
@@ -21,7 +22,8 @@
 /// It additionally fully calculates the acceleration needed for the subsequent
 /// time step, which means that time is saved because it can just be recycled.
 /// 
-/// Validation pending...
+/// The method, with the tableau, is now one of those in Butcher.h (where the
+/// stages are placed at their own times, so that it keeps its third order).
 /// </summary>
 namespace beasons
 {
@@ -32,12 +34,7 @@ namespace beasons
 	typedef std::function<C(const C&, const C&)> ReckonSecondDerivative;
 
 	/// <summary>
-	/// The results of an integration step.
-	/// 
-	/// The "strong" values are the suggested values; "weak" values
-	/// can be compared with the respective strong values to
-	/// estimate error. This allows the step size to be adapted
-	/// dynamically (functionally not included).
+	/// The results of an integration step (see `butcher::Results`).
 	/// 
 	/// Additionally, to save some compute, the acceleration for the
 	/// next time step is recorded. I can copy this `y2` value
@@ -46,15 +43,13 @@ namespace beasons
 	/// (known as FSAL --- first same as last property)
 	/// of the Bogacki-Shampine method.
 	/// </summary>
-	struct BeasonsResults
-	{
-		C y0_strong, y0_weak;
-		C y1_strong, y1_weak;
-		C y2;
-	};
+	typedef butcher::Results BeasonsResults;
 
 	/// <summary>
 	/// Evolve both y and the first derivative of y.
+	/// 
+	/// `f` may be any callable (with the signature of `ReckonSecondDerivative`),
+	/// so that it can be inlined into the stages.
 	/// </summary>
 	/// <param name="h">Step size</param>
 	/// <param name="f">How to compute the second derivative of y</param>
@@ -67,5 +62,13 @@ namespace beasons
 	/// estimate the error. It also contains the acceleration
 	/// for the next time step, which can be directly plugged in
 	/// for the next invocation of this function (into the parameter `y2`, of course).</returns>
-	BeasonsResults beason_bogacki_shampine(double h, ReckonSecondDerivative const& f, C y0, C y1, C y2 = 1. / 0.);
+	template <class F>
+	BeasonsResults beason_bogacki_shampine(double h, F const& f, C y0, C y1, C y2 = 1. / 0.)
+	{
+		return butcher::integrate<butcher::BogackiShampine32>(h, f, y0, y1, y2);
+	}
+
+	// The run-time pluggable version is compiled once, in Beasons.cpp.
+	extern template BeasonsResults beason_bogacki_shampine<ReckonSecondDerivative>(
+		double h, ReckonSecondDerivative const& f, C y0, C y1, C y2);
 }
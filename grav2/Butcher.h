@@ -0,0 +1,329 @@
+#pragma once
+#include "Include.h"
+#include <type_traits>
+
+/// <summary>
+/// Explicit Runge-Kutta methods with embedded error estimates, for the second
+/// derivative (acceleration) of y, each given by its Butcher tableau at compile time.
+///
+/// A method for first derivatives is applied to the pair (y, y') (Beason's
+/// adaptation): at stage i, the velocity is y1 + h sum a(i, j) k(j), and the
+/// position is y0 + c(i) h y1 + h^2 sum (A^2)(i, j) k(j), where k(j) are the accelerations
+/// at the earlier stages. So the method keeps its order. The step takes the
+/// solution of the higher order ("strong"), and the other ("weak") estimates the error.
+///
+/// A tableau is a type with the members
+///
+///     static constexpr int stages, order;
+///     static constexpr bool fsal;
+///     static constexpr double a(int i, int j), b(int i), bhat(int i), c(int i);
+///
+/// where b are the weights of the solution (of order `order`), and bhat those of the
+/// estimate of the error (one lower). If `fsal`, the last stage is at the end of
+/// the step (the last row of A is b), so its acceleration is that of the next step.
+///
+/// The loops over the stages and the coefficients are unrolled at compile time,
+/// and the terms whose coefficients are zero are left out.
+/// </summary>
+namespace butcher
+{
+	/// <summary>
+	/// The results of an integration step.
+	///
+	/// The "strong" values are the suggested values; "weak" values
+	/// can be compared with the respective strong values to
+	/// estimate error.
+	///
+	/// `y2` is the acceleration at the end of the step (at the strong values),
+	/// to be passed to the next step (first same as last).
+	/// </summary>
+	struct Results
+	{
+		C y0_strong, y0_weak;
+		C y1_strong, y1_weak;
+		C y2;
+	};
+
+	/// <summary>
+	/// Bogacki-Shampine 3(2): four stages, first same as last.
+	/// </summary>
+	struct BogackiShampine32
+	{
+		static constexpr int stages = 4, order = 3;
+		static constexpr bool fsal = true;
+		static constexpr double a(int i, int j)
+		{
+			double const m[4][4] = {
+				{ 0, 0, 0, 0 },
+				{ 1. / 2, 0, 0, 0 },
+				{ 0, 3. / 4, 0, 0 },
+				{ 2. / 9, 1. / 3, 4. / 9, 0 },
+			};
+			return m[i][j];
+		}
+		static constexpr double b(int i) { return a(3, i); }
+		static constexpr double bhat(int i)
+		{
+			double const m[4] = { 7. / 24, 1. / 4, 1. / 3, 1. / 8 };
+			return m[i];
+		}
+		static constexpr double c(int i)
+		{
+			double const m[4] = { 0, 1. / 2, 3. / 4, 1 };
+			return m[i];
+		}
+	};
+
+	/// <summary>
+	/// Dormand-Prince 5(4): seven stages, first same as last.
+	/// </summary>
+	struct DormandPrince54
+	{
+		static constexpr int stages = 7, order = 5;
+		static constexpr bool fsal = true;
+		static constexpr double a(int i, int j)
+		{
+			double const m[7][7] = {
+				{ 0 },
+				{ 1. / 5 },
+				{ 3. / 40, 9. / 40 },
+				{ 44. / 45, -56. / 15, 32. / 9 },
+				{ 19372. / 6561, -25360. / 2187, 64448. / 6561, -212. / 729 },
+				{ 9017. / 3168, -355. / 33, 46732. / 5247, 49. / 176, -5103. / 18656 },
+				{ 35. / 384, 0, 500. / 1113, 125. / 192, -2187. / 6784, 11. / 84 },
+			};
+			return m[i][j];
+		}
+		static constexpr double b(int i) { return a(6, i); }
+		static constexpr double bhat(int i)
+		{
+			double const m[7] = { 5179. / 57600, 0, 7571. / 16695, 393. / 640, -92097. / 339200, 187. / 2100, 1. / 40 };
+			return m[i];
+		}
+		static constexpr double c(int i)
+		{
+			double const m[7] = { 0, 1. / 5, 3. / 10, 4. / 5, 8. / 9, 1, 1 };
+			return m[i];
+		}
+	};
+
+	/// <summary>
+	/// Verner 6(5) (DVERK): eight stages. Not first same as last; the acceleration
+	/// at the end is one more evaluation (which the next step would need anyway).
+	/// </summary>
+	struct Verner65
+	{
+		static constexpr int stages = 8, order = 6;
+		static constexpr bool fsal = false;
+		static constexpr double a(int i, int j)
+		{
+			double const m[8][8] = {
+				{ 0 },
+				{ 1. / 6 },
+				{ 4. / 75, 16. / 75 },
+				{ 5. / 6, -8. / 3, 5. / 2 },
+				{ -165. / 64, 55. / 6, -425. / 64, 85. / 96 },
+				{ 12. / 5, -8, 4015. / 612, -11. / 36, 88. / 255 },
+				{ -8263. / 15000, 124. / 75, -643. / 680, -81. / 250, 2484. / 10625, 0 },
+				{ 3501. / 1720, -300. / 43, 297275. / 52632, -319. / 2322, 24068. / 84065, 0, 3850. / 26703 },
+			};
+			return m[i][j];
+		}
+		static constexpr double b(int i)
+		{
+			double const m[8] = { 3. / 40, 0, 875. / 2244, 23. / 72, 264. / 1955, 0, 125. / 11592, 43. / 616 };
+			return m[i];
+		}
+		static constexpr double bhat(int i)
+		{
+			double const m[8] = { 13. / 160, 0, 2375. / 5984, 5. / 16, 12. / 85, 3. / 44, 0, 0 };
+			return m[i];
+		}
+		static constexpr double c(int i)
+		{
+			double const m[8] = { 0, 1. / 6, 4. / 15, 2. / 3, 5. / 6, 1, 1. / 15, 1 };
+			return m[i];
+		}
+	};
+
+	/// <summary>
+	/// Values of y and its derivatives through the stages of one step
+	/// (index 0 is the start of the step).
+	///
+	/// A step of `integrate` is `start`, then `stage` and an evaluation of
+	/// the second derivative (into `y2s`) for each of the stages 1 through `T::stages` - 1,
+	/// and then `finish`. These are exposed so that many particles can be taken
+	/// through the stages together (all of them are at stage i before any goes
+	/// to stage i + 1), with one evaluation of all their second derivatives per stage.
+	/// </summary>
+	template <class T>
+	struct Stages
+	{
+		C y0s[T::stages], y1s[T::stages], y2s[T::stages];
+	};
+
+	namespace detail
+	{
+		/// <summary>
+		/// Coefficients derived from the tableau: (A^2)(i, j), and (b A)(j) and (bhat A)(j).
+		/// </summary>
+		template <class T>
+		struct Derived
+		{
+			static constexpr double aa(int i, int j)
+			{
+				double s{};
+				for (int k = 0; k < T::stages; k++) s += T::a(i, k) * T::a(k, j);
+				return s;
+			}
+			static constexpr double ba(int j)
+			{
+				double s{};
+				for (int k = 0; k < T::stages; k++) s += T::b(k) * T::a(k, j);
+				return s;
+			}
+			static constexpr double bhata(int j)
+			{
+				double s{};
+				for (int k = 0; k < T::stages; k++) s += T::bhat(k) * T::a(k, j);
+				return s;
+			}
+		};
+
+		// Rows and vectors of coefficients, as types (`at(j)`) for `Dot`.
+		template <class T, int I> struct A { static constexpr double at(int j) { return T::a(I, j); } };
+		template <class T, int I> struct AA { static constexpr double at(int j) { return Derived<T>::aa(I, j); } };
+		template <class T> struct B { static constexpr double at(int j) { return T::b(j); } };
+		template <class T> struct Bhat { static constexpr double at(int j) { return T::bhat(j); } };
+		template <class T> struct BA { static constexpr double at(int j) { return Derived<T>::ba(j); } };
+		template <class T> struct BhatA { static constexpr double at(int j) { return Derived<T>::bhata(j); } };
+
+		/// <summary>
+		/// Add w(J) k[J] to `sum`, unless w(J) is zero.
+		/// </summary>
+		template <class W, int J, bool = (W::at(J) != 0)>
+		struct Term
+		{
+			static C add(C const& sum, C const* k)
+			{
+				double constexpr w = W::at(J);
+				return sum + w * k[J];
+			}
+		};
+
+		template <class W, int J>
+		struct Term<W, J, false>
+		{
+			static C add(C const& sum, C const*) { return sum; }
+		};
+
+		/// <summary>
+		/// Sum w(j) k[j] over J &lt;= j &lt; N (unrolled).
+		/// </summary>
+		template <class W, int J, int N, bool = (J < N)>
+		struct Dot
+		{
+			static C sum(C const* k, C const& partial = C()) { return Dot<W, J + 1, N>::sum(k, Term<W, J>::add(partial, k)); }
+		};
+
+		template <class W, int J, int N>
+		struct Dot<W, J, N, false>
+		{
+			static C sum(C const*, C const& partial = C()) { return partial; }
+		};
+
+		/// <summary>
+		/// Call `g(std::integral_constant&lt;int, i&gt;())` for I &lt;= i &lt; N, in order.
+		/// </summary>
+		template <int I, int N, bool = (I < N)>
+		struct Each
+		{
+			template <class G>
+			static void run(G& g) { g(std::integral_constant<int, I>()), Each<I + 1, N>::run(g); }
+		};
+
+		template <int I, int N>
+		struct Each<I, N, false>
+		{
+			template <class G>
+			static void run(G&) {}
+		};
+	}
+
+	/// <summary>
+	/// Begin a step from y0, y1, y2 (which must be given).
+	/// </summary>
+	template <class T>
+	void start(Stages<T>& s, C const& y0, C const& y1, C const& y2)
+	{
+		s.y0s[0] = y0, s.y1s[0] = y1, s.y2s[0] = y2;
+	}
+
+	/// <summary>
+	/// Compute y and its first derivative at the stage `I` (1 &lt;= I &lt; `T::stages`), at which
+	/// the second derivative is then to be evaluated (into `s.y2s[I]`).
+	/// </summary>
+	template <class T, int I>
+	void stage(Stages<T>& s, double h)
+	{
+		using namespace detail;
+		double constexpr c = T::c(I);
+		s.y1s[I] = s.y1s[0] + h * Dot<A<T, I>, 0, I>::sum(s.y2s);
+		s.y0s[I] = s.y0s[0] + c * h * s.y1s[0] + h * h * Dot<AA<T, I>, 0, I>::sum(s.y2s);
+	}
+
+	/// <summary>
+	/// Call `g(std::integral_constant&lt;int, i&gt;())` for each stage i after the first, in order.
+	/// </summary>
+	template <class T, class G>
+	void each_stage(G&& g)
+	{
+		detail::Each<1, T::stages>::run(g);
+	}
+
+	/// <summary>
+	/// Complete a step whose stages have all been evaluated. `y2` of the results
+	/// is that of the last stage if `T::fsal`, and not a number otherwise (see `integrate`).
+	/// </summary>
+	template <class T>
+	Results finish(Stages<T> const& s, double h)
+	{
+		using namespace detail;
+		int constexpr S = T::stages;
+		Results r{};
+		r.y1_strong = s.y1s[0] + h * Dot<B<T>, 0, S>::sum(s.y2s);
+		r.y1_weak = s.y1s[0] + h * Dot<Bhat<T>, 0, S>::sum(s.y2s);
+		r.y0_strong = s.y0s[0] + h * s.y1s[0] + h * h * Dot<BA<T>, 0, S>::sum(s.y2s);
+		r.y0_weak = s.y0s[0] + h * s.y1s[0] + h * h * Dot<BhatA<T>, 0, S>::sum(s.y2s);
+		r.y2 = T::fsal ? s.y2s[S - 1] : C(1. / 0., 0);
+		return r;
+	}
+
+	/// <summary>
+	/// Evolve both y and the first derivative of y over a step with the method `T`.
+	/// </summary>
+	/// <param name="h">Step size</param>
+	/// <param name="f">How to compute the second derivative of y, callable as
+	/// `C(C const&amp; y0, C const&amp; y1)`</param>
+	/// <param name="y0">y</param>
+	/// <param name="y1">The first derivative of y</param>
+	/// <param name="y2">The second derivative of y, or a non-finite-floating-point number if must be calculated here</param>
+	/// <returns>Evolved values (see `Results`)</returns>
+	template <class T, class F>
+	Results integrate(double h, F const& f, C const& y0, C const& y1, C y2 = 1. / 0.)
+	{
+		if (!finite(y2)) y2 = f(y0, y1);
+		Stages<T> s;
+		start(s, y0, y1, y2);
+		auto g = [&](auto i)
+			{
+				int constexpr I = decltype(i)::value;
+				stage<T, I>(s, h);
+				s.y2s[I] = f(s.y0s[I], s.y1s[I]);
+			};
+		each_stage<T>(g);
+		Results r = finish(s, h);
+		if (!T::fsal) r.y2 = f(r.y0_strong, r.y1_strong);
+		return r;
+	}
+}
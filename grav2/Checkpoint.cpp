@@ -0,0 +1,241 @@
+#include "Dyn.h"
+#include "Geo2.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dyn;
+
+// Format of a checkpoint (version 2), in the byte order of the machine that wrote it:
+//
+// 1. `Header` (padded to `head` bytes).
+// 2. The columns x, y, vx, vy, ax, ay, m, r of the table: `n` doubles each.
+// 3. The levels of the time steps (`Param::blocks`, `Scheme::hermite`): `levels` 32-bit integers.
+// 4. The nodes of the lune table: `nodes` doubles (NaN if not computed).
+//
+// Fields appended to the header later are 0 (their defaults) in older files.
+// Each section starts at a multiple of 64 bytes. The whole file is assembled in
+// memory and written at once (to a temporary file, which then replaces the old one),
+// and is read back through a mapping of the file to memory.
+
+namespace
+{
+	std::uint32_t constexpr version = 2;
+
+	/// <summary>
+	/// Tag to recognize the byte order.
+	/// </summary>
+	std::uint32_t constexpr order = 0x01020304;
+
+	/// <summary>
+	/// Bytes reserved for the header.
+	/// </summary>
+	std::size_t constexpr head = 256;
+
+	struct Header
+	{
+		char magic[8];
+		std::uint32_t version, order;
+		std::int64_t n, levels, nodes;
+		/// <summary>
+		/// Size of the whole file (bytes).
+		/// </summary>
+		std::int64_t bytes;
+		// `Param`.
+		double dt, low_dt, high_dt, theta, skin;
+		std::int32_t engine, order_, blocks, precision;
+		// Totals.
+		double mass, area;
+		// `Stats`.
+		std::int64_t steps, evaluations, retries;
+		double time, prepare, gather, integrate;
+		// (Added since; 0 in older files.)
+		std::int32_t scheme, reserved_;
+		double eta, atol, rtol, merge;
+		std::int64_t merges;
+		/// <summary>
+		/// Memory of the step-size controller (`Dyn::accepted`).
+		/// </summary>
+		double accepted;
+	};
+	static_assert(sizeof(Header) <= head, "the header must fit");
+
+	char const magic[8] = { 'g', 'r', 'a', 'v', '2', 'c', 'k', 'p' };
+
+	std::size_t align(std::size_t k) { return (k + 63) / 64 * 64; }
+
+	/// <summary>
+	/// Offsets of the sections (bytes).
+	/// </summary>
+	struct Layout
+	{
+		std::size_t columns, levels, nodes, bytes;
+
+		/// <param name="n">Number of particles</param>
+		/// <param name="k">Number of levels</param>
+		/// <param name="m">Number of nodes</param>
+		Layout(std::size_t n, std::size_t k, std::size_t m)
+			: columns(head), levels(align(columns + 8 * n * sizeof(double)))
+			, nodes(align(levels + k * sizeof(std::int32_t))), bytes(nodes + m * sizeof(double)) {}
+	};
+
+	/// <summary>
+	/// Read-only mapping of a whole file to memory.
+	/// </summary>
+	class Mapping
+	{
+	public:
+		explicit Mapping(char const* path)
+		{
+#ifdef _WIN32
+			file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || !size.QuadPart) return;
+			map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!map) return;
+			data = (char const*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+			if (data) bytes = (std::size_t)size.QuadPart;
+#else
+			fd = open(path, O_RDONLY);
+			if (fd < 0) return;
+			struct stat st;
+			if (fstat(fd, &st) || st.st_size <= 0) return;
+			void* p = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) return;
+			data = (char const*)p, bytes = (std::size_t)st.st_size;
+#endif
+		}
+
+		~Mapping()
+		{
+#ifdef _WIN32
+			if (data) UnmapViewOfFile(data);
+			if (map) CloseHandle(map);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+			if (data) munmap((void*)data, bytes);
+			if (fd >= 0) close(fd);
+#endif
+		}
+
+		Mapping(Mapping const&) = delete;
+		Mapping& operator=(Mapping const&) = delete;
+
+		char const* data{};
+		std::size_t bytes{};
+
+	private:
+#ifdef _WIN32
+		HANDLE file{ INVALID_HANDLE_VALUE }, map{};
+#else
+		int fd{ -1 };
+#endif
+	};
+}
+
+bool Dyn::save(char const* path) const
+{
+	std::size_t const N = (std::size_t)n();
+	Layout const at(N, levels.size(), LuneTable::count);
+	std::vector<char> buffer(at.bytes);
+
+	Header h{};
+	std::memcpy(h.magic, magic, sizeof magic);
+	h.version = version, h.order = order;
+	h.n = (std::int64_t)N, h.levels = (std::int64_t)levels.size(), h.nodes = LuneTable::count;
+	h.bytes = (std::int64_t)at.bytes;
+	h.dt = par.dt, h.low_dt = par.low_dt, h.high_dt = par.high_dt, h.theta = par.theta, h.skin = par.skin;
+	h.engine = (std::int32_t)par.engine, h.order_ = par.order, h.blocks = par.blocks;
+	h.precision = (std::int32_t)par.precision, h.scheme = (std::int32_t)par.scheme, h.eta = par.eta;
+	h.atol = par.atol, h.rtol = par.rtol, h.merge = par.merge, h.merges = stats.merges;
+	h.accepted = accepted;
+	h.mass = m_mass, h.area = m_area;
+	h.steps = stats.steps, h.evaluations = stats.evaluations, h.retries = stats.retries;
+	h.time = stats.time, h.prepare = stats.prepare, h.gather = stats.gather, h.integrate = stats.integrate;
+	std::memcpy(buffer.data(), &h, sizeof h);
+
+	V::Column const* columns[] = { &tab.x, &tab.y, &tab.vx, &tab.vy, &tab.ax, &tab.ay, &tab.m, &tab.r };
+	for (int c = 0; c < 8; c++)
+		if (N) std::memcpy(buffer.data() + at.columns + c * N * sizeof(double), columns[c]->data(), N * sizeof(double));
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		std::int32_t const k = levels[i];
+		std::memcpy(buffer.data() + at.levels + i * sizeof k, &k, sizeof k);
+	}
+	LuneTable::shared().save((double*)(buffer.data() + at.nodes));
+
+	// (So that a crash while writing doesn't destroy the last checkpoint.)
+	std::string const temporary = std::string(path) + ".tmp";
+	std::FILE* f = std::fopen(temporary.c_str(), "wb");
+	if (!f) return false;
+	bool const written = std::fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+	if (std::fclose(f) || !written)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	return MoveFileExA(temporary.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return !std::rename(temporary.c_str(), path);
+#endif
+}
+
+bool Dyn::load(char const* path)
+{
+	Mapping const file(path);
+	if (file.bytes < head) return false;
+	Header h;
+	std::memcpy(&h, file.data, sizeof h);
+	if (std::memcmp(h.magic, magic, sizeof magic) || h.version != version || h.order != order) return false;
+	if (h.n < 0 || h.n > INT32_MAX || h.levels < 0 || h.levels > h.n || h.nodes != LuneTable::count) return false;
+	if (h.engine < 0 || h.engine > (std::int32_t)Engine::multipole) return false;
+	if (h.precision < 0 || h.precision > (std::int32_t)Precision::mixed) return false;
+	if (h.scheme < 0 || h.scheme > (std::int32_t)Scheme::hermite) return false;
+	std::size_t const N = (std::size_t)h.n;
+	Layout const at(N, (std::size_t)h.levels, (std::size_t)h.nodes);
+	if ((std::size_t)h.bytes != at.bytes || file.bytes < at.bytes) return false;
+
+	V::Column* columns[] = { &tab.x, &tab.y, &tab.vx, &tab.vy, &tab.ax, &tab.ay, &tab.m, &tab.r };
+	for (int c = 0; c < 8; c++)
+	{
+		double const* p = (double const*)(file.data + at.columns + c * N * sizeof(double));
+		columns[c]->assign(p, p + N);
+	}
+	levels.resize((std::size_t)h.levels);
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		std::int32_t k;
+		std::memcpy(&k, file.data + at.levels + i * sizeof k, sizeof k);
+		levels[i] = k;
+	}
+	LuneTable::shared().restore((double const*)(file.data + at.nodes));
+
+	par.dt = h.dt, par.low_dt = h.low_dt, par.high_dt = h.high_dt, par.theta = h.theta, par.skin = h.skin;
+	par.engine = (Engine)h.engine, par.order = h.order_, par.blocks = h.blocks != 0;
+	par.precision = (Precision)h.precision, par.scheme = (Scheme)h.scheme;
+	if (h.eta > 0) par.eta = h.eta;
+	par.atol = h.atol, par.rtol = h.rtol, par.merge = h.merge, stats.merges = h.merges;
+	accepted = h.accepted > 0 ? h.accepted : 1e-4;
+	m_mass = h.mass, m_area = h.area;
+	stats.steps = h.steps, stats.evaluations = h.evaluations, stats.retries = h.retries;
+	stats.time = h.time, stats.prepare = h.prepare, stats.gather = h.gather, stats.integrate = h.integrate;
+	// Whatever was made over the old table is stale.
+	copy = V(), quad.clear(), multipole.clear(), contacts.clear(), sums.clear();
+	fx.clear(), fy.clear(), fm.clear(), fr.clear(), jerks.clear(), before = V();
+	return true;
+}
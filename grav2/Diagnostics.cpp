@@ -0,0 +1,143 @@
+#include "Diagnostics.h"
+#include "Grid.h"
+#include "Kernel.h"
+#include <algorithm>
+
+using namespace diag;
+using dyn::Dyn;
+
+namespace
+{
+	/// <summary>
+	/// Potential energy of the pair (i, j) left out of the sums (overlapping,
+	/// or too close or far for the kernel), divided by G.
+	/// </summary>
+	double pair(Dyn::V const& tab, int i, int j)
+	{
+		double const dx = tab.x[j] - tab.x[i], dy = tab.y[j] - tab.y[i];
+		double const mm = tab.m[i] * tab.m[j];
+		if (grid::overlap(dx, dy, tab.r[i] + tab.r[j]))
+			return -mm / (tab.r[i] + tab.r[j]);
+		double const u = -mm / sqrt(dx * dx + dy * dy);
+		return std::isfinite(u) ? u : 0;
+	}
+
+	/// <summary>
+	/// Run `body` on the workers of `dyn`, if any; return the sum of
+	/// what each worker added to its own total.
+	/// </summary>
+	template <class Body>
+	double reduce(Dyn const& dyn, int n, Body const& body)
+	{
+		int const w = dyn.workers ? dyn.workers->size() : 1;
+		// (A cache line each, so that the workers don't share one.)
+		std::vector<double> totals(8 * w);
+		auto run = [&](int begin, int end, int worker) { body(begin, end, totals[8 * worker]); };
+		if (dyn.workers) dyn.workers->run(n, run);
+		else run(0, n, 0);
+		double u{};
+		for (int k = 0; k < w; k++) u += totals[8 * k];
+		return u;
+	}
+
+	/// <summary>
+	/// Sum the potential energy directly over the pairs (i, j), j &gt; i,
+	/// divided by G.
+	/// </summary>
+	double direct(Dyn const& dyn)
+	{
+		Dyn::V const& tab = dyn.tab;
+		int const n = dyn.n();
+		kernel::Sources const s{ tab.x.data(), tab.y.data(), tab.m.data(), tab.r.data() };
+		auto row = [&](int i)
+			{
+				int constexpr B = 512;
+				int deferred[B], count;
+				double u{};
+				C const z = tab.z(i);
+				for (int b = i + 1; b < n; b += B)
+				{
+					int const e = std::min(n, b + B);
+					u += tab.m[i] * kernel::potential(s, b, e, -1, z, tab.r[i], 1, deferred, count);
+					for (int k = 0; k < count; k++) u += pair(tab, i, deferred[k]);
+				}
+				return u;
+			};
+		// Row i has n - 1 - i pairs; take rows i and n - 1 - i together
+		// so that every index has about as much work.
+		return reduce(dyn, (n + 1) / 2, [&](int begin, int end, double& total)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					total += row(i);
+					if (n - 1 - i != i) total += row(n - 1 - i);
+				}
+			});
+	}
+
+	/// <summary>
+	/// Sum the potential energy with a tree (each pair is seen from both
+	/// ends, so halve it), divided by G.
+	/// </summary>
+	double summarized(Dyn const& dyn, double theta)
+	{
+		Dyn::V const& tab = dyn.tab;
+		int const n = dyn.n();
+		tree::Tree t;
+		t.theta = theta, t.G = 1;
+		t.bodies.resize(n);
+		for (int i = 0; i < n; i++)
+			t.bodies[i].z = tab.z(i), t.bodies[i].m = tab.m[i], t.bodies[i].r = tab.r[i], t.bodies[i].i = i;
+		t.build();
+		return reduce(dyn, n, [&](int begin, int end, double& total)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					double u{};
+					auto near = [&](int j) { u += pair(tab, i, j); };
+					u += tab.m[i] * t.potential(i, tab.z(i), tab.r[i], near);
+					total += u / 2;
+				}
+			});
+	}
+}
+
+Sample diag::measure(Dyn const& dyn, Method method, double theta)
+{
+	Dyn::V const& tab = dyn.tab;
+	Sample s;
+	s.step = dyn.stats.steps, s.time = dyn.stats.time;
+
+	C zcm, vcm;
+	dyn.barycenter(zcm, vcm);
+	for (int i = dyn.n() - 1; i >= 0; i--)
+	{
+		C const v = tab.v(i);
+		s.kinetic += std::norm(v) * tab.m[i];
+		s.momentum += tab.m[i] * v;
+		s.angular += tab.m[i] * (conj(tab.z(i) - zcm) * (v - vcm)).imag();
+	}
+	s.kinetic /= 2;
+
+	if (dyn.drv.gravity && dyn.n() > 1)
+		s.potential = dyn.drv.gravity * (method == Method::tree ? summarized(dyn, theta) : direct(dyn));
+	s.energy = s.kinetic + s.potential;
+	return s;
+}
+
+bool Monitor::record(Dyn const& dyn)
+{
+	if (!samples.empty() && dyn.stats.steps - samples.back().step < every)
+		return false;
+	Method const m = method != Method::automatic ? method
+		: dyn.n() < crossover ? Method::direct : Method::tree;
+	Sample s = measure(dyn, m, theta);
+	if (!samples.empty())
+	{
+		double const e0 = samples.front().energy;
+		s.drift = (s.energy - e0) / std::abs(e0);
+		peak = std::max(peak, std::abs(s.drift));
+	}
+	samples.push_back(s);
+	return true;
+}
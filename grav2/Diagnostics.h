@@ -0,0 +1,132 @@
+#pragma once
+#include "Include.h"
+#include <vector>
+#include "Dyn.h"
+#include "Tree.h"
+
+/// <summary>
+/// Diagnostics of a simulation: the conserved quantities (energy, linear and
+/// angular momentum) and how far they have drifted, sampled over time.
+///
+/// The potential energy is that of the inverse-square law (`Driver::gravity`);
+/// the pair force that replaces it for overlapping particles is not
+/// conservative, so those pairs are counted as if they just touched
+/// (-G m m / (r + r)). Without gravity, the potential energy is 0.
+///
+/// The potential energy is a sum over all pairs like the accelerations, so
+/// it's about as costly as a step: it's summed either directly, with the
+/// vectorized kernels (see Kernel.h), or with a Barnes-Hut tree (see Tree.h).
+/// Sample it every so many steps (see `Monitor::every`).
+/// </summary>
+namespace diag
+{
+	/// <summary>
+	/// The conserved quantities at one time.
+	/// </summary>
+	struct Sample
+	{
+		/// <summary>
+		/// Number of steps and simulated time (T) (see `dyn::Dyn::Stats`).
+		/// </summary>
+		long long step{};
+		double time{};
+
+		/// <summary>
+		/// Kinetic, potential, and total energy (M L L/T/T).
+		/// </summary>
+		double kinetic{}, potential{}, energy{};
+
+		/// <summary>
+		/// Relative change of the total energy since the first sample
+		/// of the series: (E - E0) / |E0|.
+		/// </summary>
+		double drift{};
+
+		/// <summary>
+		/// Linear momentum (M L/T).
+		/// </summary>
+		C momentum;
+
+		/// <summary>
+		/// Angular momentum about the barycenter, in the frame of the center
+		/// of mass (M L L/T; counterclockwise is positive).
+		/// </summary>
+		double angular{};
+	};
+
+	/// <summary>
+	/// How to sum the potential energy.
+	/// </summary>
+	enum class Method
+	{
+		/// <summary>
+		/// Direct summation for few particles, the tree for many (see `Monitor::crossover`).
+		/// </summary>
+		automatic,
+		/// <summary>
+		/// Direct summation over all pairs (exact, N^2 / 2 pairs).
+		/// </summary>
+		direct,
+		/// <summary>
+		/// Barnes-Hut tree (approximate, N log N).
+		/// </summary>
+		tree,
+	};
+
+	/// <summary>
+	/// Measure the conserved quantities of `dyn` now (`drift` is left 0).
+	/// The pairs are summed on `dyn.workers`, if any.
+	/// </summary>
+	/// <param name="method">Method (not `automatic`)</param>
+	/// <param name="theta">Opening angle of the tree (see `dyn::Dyn::Param::theta`)</param>
+	Sample measure(dyn::Dyn const& dyn, Method method = Method::direct, double theta = .5);
+
+	/// <summary>
+	/// Records a time series of the conserved quantities.
+	/// </summary>
+	class Monitor
+	{
+	public:
+		/// <summary>
+		/// Sample every this many steps (of `dyn::Dyn::Stats::steps`).
+		/// </summary>
+		int every{ 100 };
+
+		Method method{ Method::automatic };
+
+		/// <summary>
+		/// Opening angle of the tree.
+		/// </summary>
+		double theta{ .5 };
+
+		/// <summary>
+		/// Number of particles from which `Method::automatic` uses the tree.
+		/// </summary>
+		int crossover{ 4096 };
+
+		/// <summary>
+		/// Take a sample if it's time to (the first call always does).
+		/// </summary>
+		/// <returns>Whether a sample was taken</returns>
+		bool record(dyn::Dyn const& dyn);
+
+		/// <summary>
+		/// Recall the samples, oldest first.
+		/// </summary>
+		std::vector<Sample> const& series() const { return samples; }
+
+		/// <summary>
+		/// Recall the largest |drift| so far.
+		/// </summary>
+		double worst() const { return peak; }
+
+		/// <summary>
+		/// Forget the samples (the next one becomes the reference for the drift).
+		/// </summary>
+		void clear() { samples.clear(), peak = 0; }
+
+	private:
+		std::vector<Sample> samples;
+		double peak{};
+	};
+}
@@ -0,0 +1,79 @@
+#include "Drivers.h"
+
+#include <random>
+
+using namespace dyn;
+
+Sim blank()
+{
+	Sim dyn;
+	dyn.par.dt = DT;
+	// Errors of about the size that the judges object to (see `judge_z`).
+	dyn.par.atol = 1e-3, dyn.par.rtol = 1e-6;
+	dyn.workers = pool::Pool::shared();
+	dyn.drv.judge_z = judge_z;
+	dyn.drv.judge_v = judge_v;
+	dyn.drv.pair_force = newton_gravity;
+	dyn.drv.gravity = G;
+	return dyn;
+}
+
+Sim make(int n, unsigned seed)
+{
+	Sim dyn = blank();
+	{
+		// Generate this many (n) particles.
+		auto rng = std::mt19937(seed);
+		C const rot = std::polar(1., PI64 / 3);
+		for (int i = n - 1; i >= 0; i--)
+		{
+			std::uniform_real_distribution<> v(-10, 10), r(1.0, 5.0);
+			std::cauchy_distribution<> z(0., 30.), m(20, 7.); // center; scale.
+			auto sq = [](double a) { return a * a; };
+#define sca(d) d(rng)
+#define vec(d) C(sca(d), sca(d))
+			Dyn::Entry e;
+			e.z = vec(z), e.v = vec(v) + rot / abs(e.z) * e.z, e.a = 0;
+			e.m = sq(sca(m)) + 1., e.r = sq(sca(r)) + 1.;
+#undef vec
+#undef sca
+			dyn.tab.push_back(e);
+		}
+		// It is here where all accelerations are computed
+		// for before the first iteration, and where the
+		// the total mass (dyn.m_mass) is computed.
+		dyn.precompute();
+	}
+	return dyn;
+}
+
+Sim make()
+{
+	auto seed = []() { std::random_device dev; return dev(); }();
+	return make(125, seed);
+}
+
+Sim make_set1()
+{
+	Sim dyn = blank();
+	Dyn::Entry e0, e1;
+	e0.z = -10., e1.z = -e0.z;
+	e0.m = 30., e1.m = e0.m;
+	e0.r = 10., e1.r = e0.r;
+	Dyn::Entry e2(e1);
+	e2.z = 20.;
+	e2.r /= 4;
+	dyn.tab.push_back(e0);
+	dyn.tab.push_back(e1);
+	dyn.tab.push_back(e2);
+	dyn.precompute();
+	return dyn;
+}
+
+double kinetic_energy(Dyn const& dyn)
+{
+	double ke{};
+	for (int i = dyn.n() - 1; i >= 0; i--)
+		ke += std::norm(dyn.tab.v(i)) * dyn.tab.m[i];
+	return ke / 2;
+}
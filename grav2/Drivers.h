@@ -0,0 +1,161 @@
+#pragma once
+#include "Include.h"
+
+#include <algorithm>
+
+#include "Dyn.h"
+#include "Policy.h"
+#include "Geo2.h"
+
+// The behavior of the simulation (the drivers; see `dyn::Dyn::Driver`) and
+// the scenarios, shared by the window (Source.cpp) and the headless runner (Headless.cpp).
+
+/// <summary>
+/// Universal gravitational constant (units: LLL/T/T/M).
+/// </summary>
+constexpr double G = .1;
+
+/// <summary>
+/// Time step (T per frame).
+/// </summary>
+constexpr double DT = 0.005;
+
+/// <summary>
+/// Force on the left particle (l) due to the right particle (r).
+/// </summary>
+/// <returns>Force (units: ML/T/T/T)</returns>
+inline C newton_gravity(dyn::Dyn::Entry const& l, dyn::Dyn::Entry const& r)
+{
+	C s = r.z - l.z; double as = abs(s);
+
+	if (as < l.r + r.r)
+	{
+		// The circles representing them intersect.
+		// The simple calculation below doesn't apply.
+		// So, integrate the infinitesimal forces to get the total force for each
+		// small patch of the region of the left circle that is outside
+		// the right circle.
+
+		// The average of the (inverse-square) field toward the center of the right
+		// circle over that region (the lune) only depends on the ratios of
+		// the lengths, and is tabulated (see Geo2.h) in units of the left radius.
+		double avg = LuneTable::shared()(as / l.r, r.r / l.r) / (l.r * l.r);
+		// Force = G (sum of dm over the lune) (average field)
+		// = G m (average field), rotated toward the right circle.
+		C f = G * l.m * avg * (s / as);
+		return finite(f) ? f : 0;
+	}
+	else
+	{
+		C f = G * l.m * r.m * (1 / as / as / as) * s;
+		return finite(f) ? f : 0;
+	}
+}
+
+/// <summary>
+/// Compute the largest absolute value between the
+/// respective differences of the real and imaginary
+/// components of the given complex numbers `a` and `b`.
+///
+/// Complex Largest Absolute Deviation.
+/// </summary>
+inline double clad(C const& a, C const& b)
+{
+	return std::max(
+		std::abs(a.real() - b.real()),
+		std::abs(a.imag() - b.imag())
+	);
+}
+
+/// <summary>
+/// Judge the two calculated position values that should ideally be
+/// identical (but would be different if the system was too violent).
+///
+/// The specification is in the `Dyn::Driver` structure documentation.
+/// Basically, +1 expresses judgement of safety (so use a larger time
+/// step); -1 expresses concern (use a finer time step and retry the computation
+/// as appropriate); 0 expresses neutrality.
+///
+/// Strong vs. weak: this distinction is explained in the
+/// `beasons` namespace docs. See Beasons.h.
+/// Beason's method, by the way, is the chosen method of integration.
+///
+/// Basically, the strong one is the one that will be
+/// substitued in for the position value of the particle at the next time step,
+/// and the weak one is a duplicate calculation that is
+/// only provided for the estimation of error.
+/// Again, in the absense of error, strong should nearly equal weak.
+/// </summary>
+inline int judge_z(C const& strong, C const& weak)
+{
+	double c = clad(strong, weak);
+	// Units: L.
+	if (c > 0.001) return -1; // try finer time step.
+	else if (c < 0.0001) return +1; // suggest coarser time step.
+	else return 0;
+}
+
+/// <summary>
+/// Like `judge_z`, judge the velocities.
+/// </summary>
+inline int judge_v(C const& strong, C const& weak)
+{
+	double c = clad(strong, weak);
+	// Units: L/T.
+	if (c > 0.001) return -1; // try finer time step.
+	else if (c < 0.0001) return +1; // suggest coarser time step.
+	else return 0;
+}
+
+/// <summary>
+/// `newton_gravity` as a force policy (see Policy.h), so that it can be
+/// inlined into the force loops.
+/// </summary>
+struct Gravity
+{
+	C operator()(dyn::Dyn::Entry const& l, dyn::Dyn::Entry const& r) const { return newton_gravity(l, r); }
+};
+
+/// <summary>
+/// `judge_z` and `judge_v` as a judge policy.
+/// </summary>
+struct Judges
+{
+	int z(C const& strong, C const& weak) const { return judge_z(strong, weak); }
+	int v(C const& strong, C const& weak) const { return judge_v(strong, weak); }
+};
+
+/// <summary>
+/// The simulation, with the behavior fixed at compile time. (The drivers
+/// are still filled in with the same functions for whoever takes a `Dyn`.)
+/// </summary>
+typedef dyn::Static<Gravity, Judges> Sim;
+
+/// <summary>
+/// Make a simulation without particles, with the drivers filled in
+/// (e.g., to `load` a checkpoint into).
+/// </summary>
+Sim blank();
+
+/// <summary>
+/// Make a disk of `n` particles with random positions (heavy-tailed about the origin),
+/// velocities (turning about the origin), masses, and radii.
+/// </summary>
+/// <param name="n">Number of particles</param>
+/// <param name="seed">Seed of the random numbers</param>
+Sim make(int n, unsigned seed);
+
+/// <summary>
+/// Like `make(n, seed)`, with 125 particles and a random seed.
+/// </summary>
+Sim make();
+
+/// <summary>
+/// Make three particles: two equal, touching disks, and a smaller one beside them.
+/// </summary>
+Sim make_set1();
+
+/// <summary>
+/// Compute the total kinetic energy (MLL/T/T).
+/// </summary>
+double kinetic_energy(dyn::Dyn const& dyn);
@@ -1,5 +1,5 @@
 #include "Dyn.h"
-#include "Beasons.h"
+#include "Policy.h"
 
 using std::swap;
 using namespace dyn;
@@ -15,148 +15,217 @@ using namespace dyn;
 
 void Dyn::precompute()
 {
-	copy = tab;
-	for (int i = n() - 1; i >= 0; i--)
-	{
-		auto& e = copy[i];
-		m_mass += e.m;
-		m_area += e.r * e.r * PI64;
-		e.a = accelerate(i);
-	}
-	swap(tab, copy);
+	initialize(policy::DriverForce{ drv });
 }
 
 void Dyn::step()
 {
 	// Choice of integrator.
-	using namespace beasons;
-
-	// Are there cases that are too inaccurate?
-	bool go_finer{};
-
-	// Are there cases that suggest integration step size may be safely increased?
-	bool go_coarser{};
+	advance(policy::DriverForce{ drv }, policy::DriverJudge{ drv }, policy::BogackiShampine{});
+}
 
-	// There's some freedom/direction in handling the case where go_finer && go_coarser.
-	// Then either case is assuming priority.
-	// See the rest of this function body for how that's handled.
+void Dyn::accelerations()
+{
+	gather(policy::DriverForce{ drv });
+}
 
-	copy = tab;
-	for (int i = n() - 1; i >= 0; i--)
+int Dyn::merge()
+{
+	int const N = n();
+	if (!(par.merge > 0) || N < 2) return 0;
+	// Candidates from the lists of contacts (made anew if the particles moved too far).
+	contacts.skin = par.skin;
+	contacts.update(tab.x.data(), tab.y.data(), tab.r.data(), N);
+	bool const stepped = (int)levels.size() == N, jerked = (int)jerks.size() == N;
+	// Particles absorbed, and particles that merged already (in this call).
+	std::vector<char> drop(N), busy(N);
+	int merged = 0;
+	for (auto const& p : contacts.all())
 	{
-		auto& e = copy[i];
-
-		// ::: Beason's method of integration with step size adjustment. :::
-
-		// For this entry only, try with this step size.
-		// Forgotten at end of each iteration of the for-loop here.
-		double dt = par.dt;
-		// Number of times to retry in the worst case.
-		// If 0, give up.
-		int motivation = 4;
-		// Latest results from the integrator.
-		beasons::BeasonsResults aa;
+		int const i = p.first, j = p.second;
+		if (busy[i] || busy[j]) continue;
+		double const dx = tab.x[j] - tab.x[i], dy = tab.y[j] - tab.y[i], reach = tab.r[i] + tab.r[j];
+		if (!grid::overlap(dx, dy, reach)) continue;
+		if (reach - sqrt(dx * dx + dy * dy) < par.merge * std::min(tab.r[i], tab.r[j])) continue;
+		double const m = tab.m[i] + tab.m[j], wi = tab.m[i] / m, wj = tab.m[j] / m;
+		tab.set_z(i, wi * tab.z(i) + wj * tab.z(j));
+		tab.set_v(i, wi * tab.v(i) + wj * tab.v(j));
+		tab.set_a(i, wi * tab.a(i) + wj * tab.a(j));
+		tab.m[i] = m, tab.r[i] = sqrt(tab.r[i] * tab.r[i] + tab.r[j] * tab.r[j]);
+		if (stepped) levels[i] = std::max(levels[i], levels[j]);
+		if (jerked) jerks[i] = wi * jerks[i] + wj * jerks[j];
+		drop[j] = busy[i] = busy[j] = true, merged++;
+	}
+	if (!merged) return 0;
 
-		do
+	tab.remove(drop);
+	auto keep = [&](auto& column)
 		{
-			// 1. Do the math (perform the integration).
-
-			auto accel = [&](C const& z, C const& v)
-				{
-					e.z = z, e.v = v; // Destructive modification of the copied entry.
-					return accelerate(i); // e and i refer to the same entry.
-				};
-			aa = beasons::beason_bogacki_shampine(par.dt, accel, e.z, e.v, e.a);
-
-			// 2. Quality control (adjust step size).
-
-			// Map signed integers to {-1, 0, 1}, according to the sign.
-			// Note 1: (!) is boolean negation. (!!) is doing that twice,
-			// which maps all integers to {0, 1}: the output is 0 iff
-			// the number is 0.
-			// Note 2: As it happens in math, (+1) - 2 = (-1).
-			auto sign = [](int a) { return -2 * !!(a < 0) + !!a; };
-
-			if (drv.judge_z)
-			{
-				// after `sign` call:
-				// -1: inhibition, try finer time step.
-				// 0: neutral, do nothing in particular.
-				// +1: ambition, try coarser time step.
-				switch (sign(drv.judge_z(aa.y0_strong, aa.y0_weak)))
-				{
-				case -1:
-					dt = std::max(par.low_dt, dt / 2);
-					go_finer = true;
-					// Retry with less "motivation."
-					// Too little motivation causes the loop to just give up.
-					motivation--;
-					continue;
-				case 0: break; // neutral
-				case 1:
-					go_coarser = true;
-					// No need to adjust `dt` since we're moving onto
-					// another particle.
-					break;
-				}
-			}
-			if (drv.judge_v)
-			{
-				switch (sign(drv.judge_v(aa.y1_strong, aa.y1_weak)))
-				{
-				case -1:
-					dt = std::max(par.low_dt, dt / 2);
-					go_finer = true;
-					motivation--;
-					continue;
-				case 0: break;
-				case 1:
-					go_coarser = true;
-					break;
-				}
-			}
-			break;
-		} while (motivation);
-
-		e.z = aa.y0_strong;
-		e.v = aa.y1_strong;
-		e.a = aa.y2;
+			int k = 0;
+			for (int i = 0; i < N; i++) if (!drop[i]) column[k++] = column[i];
+			column.resize(k);
+		};
+	if (stepped) keep(levels);
+	if (jerked) keep(jerks);
+	m_mass = m_area = 0;
+	for (int i = n() - 1; i >= 0; i--)
+	{
+		m_mass += tab.m[i];
+		m_area += tab.r[i] * tab.r[i] * PI64;
 	}
-
-	// Apply *global* time step adjustment.
-	if (go_finer) par.dt = std::max(par.low_dt, par.dt / 2);
-	else if (go_coarser) par.dt = std::min(par.high_dt, par.dt * 2);
-
-	swap(tab, copy);
+	// The lists refer to the old indices.
+	contacts.clear();
+	stats.merges += merged;
+	return merged;
 }
 
 void Dyn::bias()
 {
 	// Barycenter and momentum.
 	C zcm, vcm;
+	barycenter(zcm, vcm);
+	// The start of the last step moves along, so that `interpolate` stays in one frame:
+	// one that moves with the barycenter, which was at zcm - vcm h at the start.
+	double const h = stats.time - since;
+	C const z0 = zcm - (h > 0 ? h : 0) * vcm;
+	parallel(n(), [&](int begin, int end, int)
+		{
+			for (int i = begin; i < end; i++)
+				tab.x[i] -= zcm.real(), tab.y[i] -= zcm.imag(), tab.vx[i] -= vcm.real(), tab.vy[i] -= vcm.imag();
+			if (before.size() == tab.size())
+				for (int i = begin; i < end; i++)
+					before.x[i] -= z0.real(), before.y[i] -= z0.imag(), before.vx[i] -= vcm.real(), before.vy[i] -= vcm.imag();
+		});
+}
+
+void Dyn::interpolate(int i, double t, C& z, C& v) const
+{
+	double const h = stats.time - since;
+	if (before.size() != tab.size() || !(h > 0))
+	{
+		z = tab.z(i), v = tab.v(i);
+		return;
+	}
+	// (Accelerations that are not known are taken as 0.)
+	C const a0 = finite(before.a(i)) ? before.a(i) : 0, a1 = finite(tab.a(i)) ? tab.a(i) : 0;
+	double const s = (t - since) / h, s2 = s * s, s3 = s2 * s, s4 = s3 * s, s5 = s4 * s;
+	// Quintic Hermite basis (for the position, velocity, and acceleration
+	// at the start, and then at the end), and its derivatives.
+	double const h0 = 1 - 10 * s3 + 15 * s4 - 6 * s5, h3 = 1 - h0;
+	double const h1 = s - 6 * s3 + 8 * s4 - 3 * s5, h4 = -4 * s3 + 7 * s4 - 3 * s5;
+	double const h2 = (s2 - 3 * s3 + 3 * s4 - s5) / 2, h5 = (s3 - 2 * s4 + s5) / 2;
+	double const d0 = -30 * s2 + 60 * s3 - 30 * s4;
+	double const d1 = 1 - 18 * s2 + 32 * s3 - 15 * s4, d4 = -12 * s2 + 28 * s3 - 15 * s4;
+	double const d2 = (2 * s - 9 * s2 + 12 * s3 - 5 * s4) / 2, d5 = (3 * s2 - 8 * s3 + 5 * s4) / 2;
+	C const z0 = before.z(i), v0 = before.v(i), z1 = tab.z(i), v1 = tab.v(i);
+	z = h0 * z0 + h3 * z1 + h * (h1 * v0 + h4 * v1) + h * h * (h2 * a0 + h5 * a1);
+	v = d0 * (z0 - z1) / h + d1 * v0 + d4 * v1 + h * (d2 * a0 + d5 * a1);
+}
+
+void Dyn::barycenter(C& zcm, C& vcm) const
+{
+	zcm = vcm = 0;
 	// Since numerical stability is a problem, use the numerically stable method
 	// of Welford's online algorithm to compute the arithmetic mean of the relevant vectors.
-#define e tab[i - 1]
-#define put(avg, term) avg += ((term) - avg) / (double)i
-	for (int i = 1; i <= n(); i++) put(zcm, e.z * e.m), put(vcm, e.v * e.m);
-	zcm /= m_mass, vcm /= m_mass;
-	for (int i = 1; i <= n(); i++) e.z -= zcm, e.v -= vcm;
+	// Each worker computes the means of its own ranges, which are then combined
+	// (weighted by the number of particles).
+	struct Means { C zcm, vcm; int count{}; char padding[28]; };
+	std::vector<Means> means(concurrency());
+	parallel(n(), [&](int begin, int end, int worker)
+		{
+			auto& mu = means[worker];
+#define put(avg, term) avg += ((term) - avg) / (double)mu.count
+			for (int i = begin; i < end; i++)
+				mu.count++, put(mu.zcm, tab.z(i) * tab.m[i]), put(mu.vcm, tab.v(i) * tab.m[i]);
 #undef put
-#undef e
+		});
+	for (auto const& mu : means)
+		if (mu.count)
+			zcm += mu.zcm * (mu.count / (double)n()), vcm += mu.vcm * (mu.count / (double)n());
+	// Means of m z and m v, times n, over the total mass.
+	zcm *= n() / m_mass, vcm *= n() / m_mass;
 }
 
-/// <summary>
-/// Compute the acceleration felt by particle at index `i` if it were at
-/// the hypothetical location z.
-/// </summary>
-/// <param name="i">Valid index of the particle</param>
-/// <param name="z">The particle's hypothetical location</param>
-/// <returns>Acceleration, or force divided by the particle's mass</returns>
-C Dyn::accelerate(int i) const
+double Dyn::error(Entry const& start, butcher::Results const& r) const
 {
-	if (!drv.pair_force) return 0;
-	Entry e(tab[i]);
-	C f;
-	for (int j = n() - 1; j >= 0; j--) if (i != j) f += drv.pair_force(e, tab[j]);
-	return f / e.m;
+	double sum{};
+	auto add = [&](double y0, double y, double weak)
+		{
+			double const d = (y - weak) / (par.atol + par.rtol * std::max(std::abs(y0), std::abs(y)));
+			sum += d * d;
+		};
+	add(start.z.real(), r.y0_strong.real(), r.y0_weak.real()), add(start.z.imag(), r.y0_strong.imag(), r.y0_weak.imag());
+	add(start.v.real(), r.y1_strong.real(), r.y1_weak.real()), add(start.v.imag(), r.y1_strong.imag(), r.y1_weak.imag());
+	return sqrt(sum / 4);
+}
+
+double Dyn::control(double err, int order, bool rejected)
+{
+	// The error goes as dt^order. A safety factor keeps the next step from
+	// just missing; the gain is limited either way (see Hairer, Norsett,
+	// and Wanner, "Solving Ordinary Differential Equations I", II.4).
+	double constexpr safety = .9, most = 5;
+	double f;
+	if (!(err <= 1))
+		f = std::max(1 / most, safety * std::pow(err, -1. / order));
+	else
+	{
+		// Proportional to this error, and integral of the last (Gustafsson's PI controller).
+		err = std::max(err, 1e-10);
+		f = safety * std::pow(err, -.7 / order) * std::pow(accepted, .4 / order);
+		f = std::max(1 / most, std::min(rejected ? 1 : most, f));
+		accepted = std::max(err, 1e-4);
+	}
+	return std::max(par.low_dt, std::min(par.high_dt, par.dt * f));
+}
+
+void Dyn::parallel(int n, pool::Pool::Body const& body) const
+{
+	if (workers) workers->run(n, body);
+	else if (n > 0) body(0, n, 0);
+}
+
+void Dyn::prepare(bool forces, bool engines)
+{
+	Lap lap(stats.prepare);
+	quad.clear(), multipole.clear();
+	fx.clear(), fy.clear(), fm.clear(), fr.clear();
+	if (!drv.gravity || !forces)
+	{
+		contacts.clear();
+		return;
+	}
+	contacts.skin = par.skin;
+	contacts.update(tab.x.data(), tab.y.data(), tab.r.data(), n());
+	if (!engines) return;
+	if (par.engine == Engine::direct)
+	{
+		if (par.precision != Precision::mixed) return;
+		// Relative to the barycenter, so that the positions keep their digits.
+		C vcm;
+		barycenter(origin, vcm);
+		fx.resize(n()), fy.resize(n()), fm.resize(n()), fr.resize(n());
+		for (int i = n() - 1; i >= 0; i--)
+		{
+			fx[i] = (float)(tab.x[i] - origin.real()), fy[i] = (float)(tab.y[i] - origin.imag());
+			fm[i] = (float)tab.m[i], fr[i] = (float)tab.r[i];
+		}
+		return;
+	}
+	// Both engines are built over the same bodies.
+	auto& bodies = par.engine == Engine::tree ? quad.bodies : multipole.quad.bodies;
+	bodies.resize(tab.size());
+	for (int i = n() - 1; i >= 0; i--) bodies[i] = tree::Body{ tab.z(i), tab.m[i], tab.r[i], i };
+	switch (par.engine)
+	{
+	case Engine::tree:
+		quad.theta = par.theta, quad.G = drv.gravity;
+		quad.build();
+		break;
+	case Engine::multipole:
+		multipole.theta = par.theta, multipole.order = par.order, multipole.G = drv.gravity;
+		multipole.build();
+		break;
+	default: break;
+	}
 }
@@ -2,6 +2,13 @@
 #include "Include.h"
 #include <vector>
 #include <functional>
+#include <chrono>
+#include "Butcher.h"
+#include "Tree.h"
+#include "Fmm.h"
+#include "Pool.h"
+#include "Table.h"
+#include "Grid.h"
 
 /// <summary>
 /// Accounting of movements (kinematics) and of forces (dynamics).
@@ -29,6 +36,99 @@ namespace dyn
 	class Dyn
 	{
 	public:
+		/// <summary>
+		/// Method of summing the pairwise forces.
+		/// </summary>
+		enum class Engine
+		{
+			/// <summary>
+			/// Sum `Driver::pair_force` over all pairs (exact, O(N^2)).
+			/// 
+			/// If `Driver::gravity` is given, the inverse-square law is summed
+			/// with a vectorized kernel (see Kernel.h) instead.
+			/// </summary>
+			direct,
+			/// <summary>
+			/// Barnes-Hut quadtree (approximate, O(N log N)). Distant groups are
+			/// summarized with the inverse-square law (see `Driver::gravity`);
+			/// nearby particles are summed one at a time.
+			/// </summary>
+			tree,
+			/// <summary>
+			/// Fast multipole method (approximate, O(N)). Like `tree`, but
+			/// distant groups interact with each other through expansions of
+			/// order `Param::order`, not with individual particles.
+			/// </summary>
+			multipole,
+		};
+
+		/// <summary>
+		/// Floating-point precision of the sums of the pairwise forces.
+		/// </summary>
+		enum class Precision
+		{
+			/// <summary>
+			/// Double precision throughout.
+			/// </summary>
+			full,
+			/// <summary>
+			/// With `Engine::direct`, the inverse-square law at the positions tried
+			/// by the integrator (`accelerate`) is evaluated in single precision and
+			/// summed in double precision (see `kernel::gravity`); everything else,
+			/// including the state and the close-range forces, stays in double precision.
+			/// </summary>
+			mixed,
+		};
+
+		/// <summary>
+		/// How the particles go through the stages of the integrator (`step`,
+		/// without `Param::blocks`).
+		/// </summary>
+		enum class Scheme
+		{
+			/// <summary>
+			/// Each particle goes through all the stages on its own, against the
+			/// others as they were at the start of the step (one evaluation of
+			/// its acceleration per stage).
+			/// </summary>
+			independent,
+			/// <summary>
+			/// All particles go through each stage together: their positions at
+			/// the stage are computed first, and then all their accelerations at once
+			/// (`accelerations`, on the chosen engine). The stages see each other,
+			/// as the method intends for a system of equations.
+			/// </summary>
+			coupled,
+			/// <summary>
+			/// Kick-drift-kick leapfrog (second order, symplectic): one evaluation of
+			/// all accelerations per step (the last one is reused). The time step
+			/// stays as it is (the judges are not consulted), since changing it
+			/// would spoil the conservation over long runs.
+			/// </summary>
+			leapfrog,
+			/// <summary>
+			/// Forest-Ruth (Yoshida's fourth order, symplectic): three leapfrog steps
+			/// of w dt, (1 - 2w) dt, and w dt, where w = 1 / (2 - 2^(1/3)). Three evaluations
+			/// per step. Like `leapfrog`, the time step stays as it is.
+			/// </summary>
+			forest_ruth,
+			/// <summary>
+			/// Fourth-order Hermite predictor-corrector, with each particle's own time step
+			/// (in hierarchical blocks under `Param::dt`, as with `Param::blocks`), chosen by
+			/// Aarseth's criterion (see `Param::eta`) instead of the judges.
+			/// One evaluation of the acceleration and the jerk (its time derivative) per
+			/// particle per step of its own, both summed in the same loop over the pairs:
+			/// all particles are predicted to the time of the particles that are due
+			/// (from their accelerations and jerks), and then those are corrected.
+			/// 
+			/// The jerk is that of the inverse-square law (`Driver::gravity`); the
+			/// forces between overlapping particles (or, without `gravity`, all of
+			/// `Driver::pair_force`) only count towards the acceleration. The pairs are
+			/// summed directly, in double precision, whatever `Param::engine` and `Param::precision` say.
+			/// </summary>
+			hermite,
+		};
+
 		/// <summary>
 		/// Simulation parameters in world units.
 		/// </summary>
@@ -44,6 +144,94 @@ namespace dyn
 			/// time step integrator.
 			/// </summary>
 			double low_dt{ 0.000005 }, high_dt{ 0.05 };
+
+			/// <summary>
+			/// Method of summing the pairwise forces.
+			/// </summary>
+			Engine engine{ Engine::direct };
+
+			/// <summary>
+			/// Opening angle of the tree (`Engine::tree`), or the separation
+			/// criterion of the cells (`Engine::multipole`). Smaller is more accurate.
+			/// </summary>
+			double theta{ 0.5 };
+
+			/// <summary>
+			/// Floating-point precision of the sums of the pairwise forces.
+			/// </summary>
+			Precision precision{ Precision::full };
+
+			/// <summary>
+			/// Order of the expansions (`Engine::multipole`). Higher is more accurate.
+			/// 
+			/// The error goes down about like `theta` to the power of the order. At theta 0.5,
+			/// the worst relative error of the force (against direct summation) is about
+			/// 4% at order 6, 0.3% at 10, and 0.08% at 12, which is about that of the tree
+			/// at the same theta (0.07%), for about a third more time than order 6.
+			/// </summary>
+			int order{ 12 };
+
+			/// <summary>
+			/// Whether to give each particle its own time step (hierarchical block time steps).
+			/// 
+			/// If so, `dt` is the length of a whole `step` (a block), and each particle
+			/// takes steps of dt / 2^k for its own level k (at least `low_dt`).
+			/// A particle's level goes up when the judges object, and down when they
+			/// suggest so at a time that is a multiple of the coarser step.
+			/// Only the particles that are due are integrated at each sub-step,
+			/// against the others' positions predicted to that time. `dt` itself
+			/// only changes when all particles agree.
+			/// 
+			/// If not (default), all particles share the step `dt`, which is halved as soon as
+			/// any particle objects.
+			/// </summary>
+			bool blocks{};
+
+			/// <summary>
+			/// How the particles go through the stages of the integrator
+			/// (not with `blocks`, except for `Scheme::hermite`, which has blocks of its own).
+			/// </summary>
+			Scheme scheme{ Scheme::independent };
+
+			/// <summary>
+			/// Accuracy of Aarseth's criterion for the time steps (`Scheme::hermite`);
+			/// smaller is more accurate. A particle's step is at most
+			/// 
+			///     sqrt(eta (|a| |a2| + |a1|^2) / (|a1| |a3| + |a2|^2)),
+			/// 
+			/// where a is its acceleration and ak the k-th time derivative of a
+			/// (at the end of its last step).
+			/// </summary>
+			double eta{ 0.02 };
+
+			/// <summary>
+			/// Absolute (L, and L/T) and relative tolerances of the error control
+			/// (`Scheme::independent` and `Scheme::coupled`).
+			/// 
+			/// If `atol` is positive, each step is judged by the norm of its error estimate
+			/// (see `Dyn::error`), the largest of all particles: over 1, the step is rejected and taken again,
+			/// shorter, from the same accelerations at its start (first same as last); the length
+			/// of the next step follows from the norm with a PI controller (see `Dyn::control`), within
+			/// [`low_dt`, `high_dt`]. The judges are not consulted.
+			/// 
+			/// If not (default), the judges vote for halving or doubling the time step.
+			/// </summary>
+			double atol{}, rtol{};
+
+			/// <summary>
+			/// Depth of the overlap of two particles, as a fraction of the smaller radius, from
+			/// which they merge into one (see `Dyn::merge`), at the start of each `step`:
+			/// 1 when the center of the smaller one reaches the edge of the other, 2 when it's
+			/// inside. 0 (default): particles never merge.
+			/// </summary>
+			double merge{};
+
+			/// <summary>
+			/// Margin (L) of the lists of possibly overlapping pairs (see Grid.h): two
+			/// particles are listed if they come within this distance of each other.
+			/// The lists are made anew once particles have moved half as far.
+			/// </summary>
+			double skin{ 1 };
 		};
 
 		/// <summary>
@@ -63,6 +251,10 @@ namespace dyn
 			/// <summary>
 			/// Compute the force on the left (first) particle by the right (second) particle.
 			/// 
+			/// Of the right particle, only the position, the mass, and the radius are
+			/// filled in (the velocity and the acceleration are zero), so that the
+			/// force loops need not read the other columns of the table.
+			/// 
 			/// If this doesn't exist, then the accelerations will either be untouched
 			/// after each `step` call or it will be reset to zero.
 			/// </summary>
@@ -94,9 +286,72 @@ namespace dyn
 			/// If not exist: No suggestion will be made.
 			/// </summary>
 			std::function<int(C const& strong, C const& weak)> judge_v;
+
+			/// <summary>
+			/// Gravitational constant (LLL/T/T/M) of the inverse-square law that
+			/// `pair_force` agrees with whenever the two particles do not overlap.
+			/// 
+			/// The approximate engines (see `Engine`) summarize distant particles
+			/// with this law, and direct summation evaluates it with a vectorized kernel.
+			/// Then `pair_force` is only called for the pairs that overlap, which are
+			/// found with a broad phase (see Grid.h and `Param::skin`).
+			/// If this is 0 (the default), the approximate engines are unavailable,
+			/// and direct summation calls `pair_force` for every pair.
+			/// </summary>
+			double gravity{};
+
+			/// <summary>
+			/// Whether `pair_force` obeys Newton's third law: the force on the right particle
+			/// by the left is always the opposite of the force on the left by the right.
+			/// 
+			/// If so, `accelerations` calls `pair_force` once per pair of particles
+			/// instead of twice. (The pairs summed with the inverse-square law, see `gravity`,
+			/// are computed once per pair regardless.)
+			/// </summary>
+			bool symmetric{};
+		};
+
+		/// <summary>
+		/// Counts of the work done, and the wall time it took, since the simulation was made.
+		/// </summary>
+		struct Stats
+		{
+			/// <summary>
+			/// Calls to `step`.
+			/// </summary>
+			long long steps{};
+
+			/// <summary>
+			/// Simulated time (T): the sum of the lengths of the steps.
+			/// </summary>
+			double time{};
+
+			/// <summary>
+			/// Accelerations of single particles computed (by the integrator, or all at once).
+			/// Each is worth N - 1 pair interactions with direct summation.
+			/// </summary>
+			long long evaluations{};
+
+			/// <summary>
+			/// Integrations of single particles redone (with a finer step) because a judge objected,
+			/// or the error control rejected the step (see `Param::atol`).
+			/// </summary>
+			long long retries{};
+
+			/// <summary>
+			/// Particles absorbed into others (see `Param::merge`).
+			/// </summary>
+			long long merges{};
+
+			/// <summary>
+			/// Wall time (s) spent preparing the engines and the lists of contacts (see `prepare`);
+			/// computing all accelerations at once (`precompute`, `accelerations`), apart from
+			/// the preparation; and integrating (`step`), apart from the preparation.
+			/// </summary>
+			double prepare{}, gather{}, integrate{};
 		};
 
-		typedef std::vector<Entry> V;
+		typedef Table<Entry> V;
 
 		/// <summary>
 		/// Exposed simulation parameters.
@@ -104,13 +359,24 @@ namespace dyn
 		Param par;
 		/// <summary>
 		/// Exposed dynamical table. (Stores all kinematical and dynamical variables
-		/// of all particles). Do not exceed the size of `int` (signed).
+		/// of all particles, column by column). Do not exceed the size of `int` (signed).
 		/// </summary>
 		V tab;
 		/// <summary>
 		/// Exposed set of drivers.
 		/// </summary>
 		Driver drv;
+		/// <summary>
+		/// Threads to share the work of `precompute`, `step`, and `bias` among.
+		/// If null (default), everything is done on the calling thread.
+		/// 
+		/// The drivers are then called from several threads at once.
+		/// </summary>
+		std::shared_ptr<pool::Pool> workers;
+		/// <summary>
+		/// Counts of the work done (for benchmarks).
+		/// </summary>
+		Stats stats;
 
 	private:
 		/// <summary>
@@ -119,6 +385,47 @@ namespace dyn
 		/// </summary>
 		V copy;
 
+		/// <summary>
+		/// Quadtree over `tab` (`Engine::tree`), made at the same times as `copy`.
+		/// </summary>
+		tree::Tree quad;
+
+		/// <summary>
+		/// Multipole expansions over `tab` (`Engine::multipole`), made at the same
+		/// times as `copy`.
+		/// </summary>
+		fmm::Fmm multipole;
+
+		/// <summary>
+		/// Lists of possibly overlapping pairs (if `Driver::gravity` is given),
+		/// brought up to date at the same times as `copy` is made.
+		/// </summary>
+		grid::Contacts contacts;
+
+		/// <summary>
+		/// Accumulators of the accelerations, two columns per worker (`pairwise`).
+		/// </summary>
+		std::vector<V::Column> sums;
+
+		/// <summary>
+		/// Positions (relative to `origin`), masses, and radii of `tab` in single
+		/// precision (`Precision::mixed`), made at the same times as `copy`.
+		/// </summary>
+		std::vector<float, Aligned<float>> fx, fy, fm, fr;
+		C origin;
+
+		/// <summary>
+		/// The table at the start of the last step, and the time then (T) (see `interpolate`).
+		/// Not copied with the rest.
+		/// </summary>
+		V before;
+		double since{};
+
+		/// <summary>
+		/// Error norm of the last step accepted (`Param::atol`; see `control`).
+		/// </summary>
+		double accepted{ 1e-4 };
+
 		/// <summary>
 		/// Sum of the masses of all particles.
 		/// </summary>
@@ -129,6 +436,17 @@ namespace dyn
 		/// </summary>
 		double m_area{ 0 };
 
+		/// <summary>
+		/// Level of the time step of each particle (`Param::blocks`, `Scheme::hermite`).
+		/// </summary>
+		std::vector<int> levels;
+
+		/// <summary>
+		/// Jerk (L/T/T/T) of each particle at the end of its last step (`Scheme::hermite`).
+		/// Made again when missing (it isn't copied or saved).
+		/// </summary>
+		std::vector<C> jerks;
+
 	public:
 		// Try not to clone or move `copy` (copy of the table)
 		// because it's only for storage optimizations (save allocations).
@@ -139,42 +457,39 @@ namespace dyn
 		Dyn() = default;
 		Dyn(Param const& par) : par(par) {}
 		Dyn(Dyn const& dyn)
-			: par(dyn.par), tab(dyn.tab), drv(dyn.drv), copy()
-			, m_mass(dyn.m_mass), m_area(dyn.m_area) {}
+			: par(dyn.par), tab(dyn.tab), drv(dyn.drv), workers(dyn.workers), stats(dyn.stats), copy()
+			, accepted(dyn.accepted), m_mass(dyn.m_mass), m_area(dyn.m_area), levels(dyn.levels) {}
 		Dyn(Dyn&& dyn) noexcept
-			: par(dyn.par), tab(std::move(dyn.tab)), drv(dyn.drv), copy()
-			, m_mass(dyn.m_mass), m_area(dyn.m_area) {}
+			: par(dyn.par), tab(std::move(dyn.tab)), drv(dyn.drv), workers(dyn.workers), stats(dyn.stats), copy()
+			, accepted(dyn.accepted), m_mass(dyn.m_mass), m_area(dyn.m_area), levels(std::move(dyn.levels)) {}
 
 		Dyn& operator=(Dyn const& dyn) noexcept
 		{
 			if (&dyn == this) return *this;
-			par = dyn.par, tab = dyn.tab, drv = dyn.drv;
-			m_mass = dyn.m_mass, m_area = dyn.m_area;
-			copy = V();
+			par = dyn.par, tab = dyn.tab, drv = dyn.drv, workers = dyn.workers, stats = dyn.stats;
+			accepted = dyn.accepted, m_mass = dyn.m_mass, m_area = dyn.m_area, levels = dyn.levels;
+			copy = V(), quad = tree::Tree(), multipole = fmm::Fmm(), contacts = grid::Contacts(), sums.clear();
+			fx.clear(), fy.clear(), fm.clear(), fr.clear(), jerks.clear(), before = V();
 			return *this;
 		}
 
 		Dyn& operator=(Dyn&& dyn) noexcept
 		{
 			if (&dyn == this) return *this;
-			par = dyn.par, drv = dyn.drv;
-			m_mass = dyn.m_mass, m_area = dyn.m_area;
-			tab = std::move(dyn.tab);
-			copy = V();
+			par = dyn.par, drv = dyn.drv, workers = dyn.workers, stats = dyn.stats;
+			accepted = dyn.accepted, m_mass = dyn.m_mass, m_area = dyn.m_area;
+			tab = std::move(dyn.tab), levels = std::move(dyn.levels);
+			copy = V(), quad = tree::Tree(), multipole = fmm::Fmm(), contacts = grid::Contacts(), sums.clear();
+			fx.clear(), fy.clear(), fm.clear(), fr.clear(), jerks.clear(), before = V();
 			return *this;
 		}
 
 		/// <summary>
-		/// Access an entry (particle) in the table.
-		/// </summary>
-		/// <param name="i">Index</param>
-		Entry& operator[](int i) { return tab[i]; }
-
-		/// <summary>
-		/// Access an entry (particle) in the table.
+		/// Read an entry (particle) in the table. This is a copy;
+		/// write it back with `tab.set`.
 		/// </summary>
 		/// <param name="i">Index</param>
-		Entry const& operator[](int i) const { return tab[i]; }
+		Entry operator[](int i) const { return tab[i]; }
 
 		/// <summary>
 		/// 1. Find and store the total mass and area.
@@ -187,6 +502,29 @@ namespace dyn
 		/// </summary>
 		void step();
 
+		/// <summary>
+		/// Compute the accelerations of all particles at their current positions
+		/// (in `tab`) at once.
+		/// 
+		/// With direct summation (`Engine::direct`), each pair of particles is visited
+		/// only once, and the force is applied to both (see `Driver::symmetric`).
+		/// </summary>
+		void accelerations();
+
+		/// <summary>
+		/// Merge each pair of particles that overlap by at least `Param::merge` into one
+		/// (the one of the lower index absorbs the other, which is removed from `tab`):
+		/// the mass, the momentum, and the area are conserved, so the merged particle is at
+		/// the center of mass, with its velocity and acceleration, and its radius is the root
+		/// of the sum of the squared radii. A particle merges with one other at a time; if it
+		/// overlaps more, those merge at the next call.
+		/// 
+		/// The levels of the time steps (the finer of the two) and the jerks (weighted like
+		/// the accelerations) are merged too, and the totals (`mass`, `area`) are summed anew.
+		/// </summary>
+		/// <returns>Number of particles absorbed</returns>
+		int merge();
+
 		/// <summary>
 		/// De-bias the positions and velocities
 		/// by locating the barycenter at (0, 0) and
@@ -194,11 +532,52 @@ namespace dyn
 		/// </summary>
 		void bias();
 
+		/// <summary>
+		/// Compute the barycenter (L) and the velocity of the center of mass (L/T),
+		/// the ones that `bias` moves to (0, 0).
+		/// </summary>
+		void barycenter(C& zcm, C& vcm) const;
+
+		/// <summary>
+		/// Interpolate the position and velocity of the particle `i` at the time `t` (T)
+		/// within the last step, from `began()` to `stats.time` (dense output).
+		/// 
+		/// The interpolant is the quintic Hermite polynomial through the position,
+		/// velocity, and acceleration at both ends of the step, so the steps can be
+		/// long while frames are still drawn or recorded at exact times. Without a
+		/// last step (e.g., after `load`, or if the number of particles changed),
+		/// it's the current state.
+		/// </summary>
+		/// <param name="z">Position (L)</param>
+		/// <param name="v">Velocity (L/T)</param>
+		void interpolate(int i, double t, C& z, C& v) const;
+
+		/// <summary>
+		/// Recall the time (T) at the start of the last step (see `interpolate`).
+		/// </summary>
+		double began() const { return before.size() == tab.size() ? since : stats.time; }
+
+		/// <summary>
+		/// Write a checkpoint to the file at `path` (replacing it; see Checkpoint.cpp for
+		/// the format): the table (including the accelerations), `par`, `stats`, the totals,
+		/// the levels of the time steps, and the computed nodes of the lune table (see Geo2.h).
+		/// </summary>
+		/// <returns>Whether it was written</returns>
+		bool save(char const* path) const;
+
+		/// <summary>
+		/// Read a checkpoint written by `save`, so that `step` can go on without `precompute`.
+		/// The drivers and the workers, which aren't saved, are kept as they are.
+		/// If it can't be read (or is of another version), nothing is changed.
+		/// </summary>
+		/// <returns>Whether it was read</returns>
+		bool load(char const* path);
+
 		/// <summary>
 		/// Count the number of particles.
 		/// </summary>
 		/// <returns></returns>
-		int n() const { return (int)tab.size(); }
+		int n() const { return tab.size(); }
 
 		/// <summary>
 		/// Recall the total mass of particles.
@@ -212,13 +591,145 @@ namespace dyn
 		/// </summary>
 		double area() const { return m_area; }
 
-	private:
+	protected:
+		// The generic parts of `precompute` and `step`, parameterized on the
+		// behavior (policies; see Policy.h). `precompute` and `step` use
+		// the run-time pluggable drivers (`drv`); `Static` uses policies known
+		// at compile time, which the compiler can inline.
+
+		/// <summary>
+		/// Like `precompute`, but with the given pair force.
+		/// </summary>
+		/// <typeparam name="Force">Callable as `C(Entry const&amp; l, Entry const&amp; r)`
+		/// (see `Driver::pair_force`)</typeparam>
+		template <class Force>
+		void initialize(Force const& force);
+
+		/// <summary>
+		/// Like `accelerations`, but with the given pair force.
+		/// </summary>
+		/// <typeparam name="Force">See `initialize`</typeparam>
+		template <class Force>
+		void gather(Force const& force);
+
+		/// <summary>
+		/// Sum the forces over all pairs of particles in `tab` (each pair once), and
+		/// store the accelerations in `tab`. Each worker scatters into its
+		/// own accumulators, which are added up at the end.
+		/// </summary>
+		/// <typeparam name="Force">See `initialize`</typeparam>
+		template <class Force>
+		void pairwise(Force const& force);
+
+		/// <summary>
+		/// Like `step`, but with the given pair force, judges, and integrator.
+		/// </summary>
+		/// <typeparam name="Force">See `initialize`</typeparam>
+		/// <typeparam name="Judge">Has the members `int z(C const&amp; strong, C const&amp; weak)`
+		/// and `int v(C const&amp; strong, C const&amp; weak)` (see `Driver::judge_z`)</typeparam>
+		/// <typeparam name="Integrator">Callable as `beason_bogacki_shampine` is</typeparam>
+		template <class Force, class Judge, class Integrator>
+		void advance(Force const& force, Judge const& judge, Integrator const& integrate);
+
+		/// <summary>
+		/// `advance` with all particles going through the stages together (see `Scheme::coupled`).
+		/// </summary>
+		template <class Force, class Judge, class Integrator>
+		void couple(Force const& force, Judge const& judge, Integrator const& integrate);
+
+		/// <summary>
+		/// `advance` with a symplectic scheme (see `Scheme::leapfrog` and `Scheme::forest_ruth`).
+		/// </summary>
+		template <class Force>
+		void leap(Force const& force);
+
+		/// <summary>
+		/// `advance` with the Hermite scheme (see `Scheme::hermite`).
+		/// </summary>
+		template <class Force>
+		void hermite(Force const& force);
+
+		/// <summary>
+		/// `advance` with hierarchical block time steps (see `Param::blocks`).
+		/// </summary>
+		template <class Force, class Judge, class Integrator>
+		void subcycle(Force const& force, Judge const& judge, Integrator const& integrate);
+
 		/// <summary>
 		/// Compute the acceleration felt by particle at index `i` if it were at
 		/// the hypothetical location z.
 		/// </summary>
 		/// <param name="i">Valid index of the particle</param>
+		/// <param name="z">The particle's hypothetical location</param>
+		/// <param name="force">The pair force</param>
 		/// <returns>Acceleration, or force divided by the particle's mass</returns>
-		C accelerate(int i) const;
+		template <class Force>
+		C accelerate(int i, C const& z, Force const& force) const;
+
+		/// <summary>
+		/// Compute the acceleration and the jerk of the particle at index `i`
+		/// at its position and velocity in `tab`, summed directly (see `Scheme::hermite`).
+		/// </summary>
+		/// <param name="a">Acceleration (L/T/T)</param>
+		/// <param name="jerk">Jerk (L/T/T/T)</param>
+		template <class Force>
+		void differentiate(int i, C& a, C& jerk, Force const& force) const;
+
+		/// <summary>
+		/// Compute the norm of the error estimate of a step of one particle from `start`:
+		/// the root mean square of the differences between the strong and the weak
+		/// position and velocity (see `butcher::Results`), component by component, each over
+		/// `Param::atol` plus `Param::rtol` times the larger magnitude of the component
+		/// at the start and at the end. Within the tolerances if at most 1.
+		/// </summary>
+		double error(Entry const& start, butcher::Results const& r) const;
+
+		/// <summary>
+		/// Choose the length of the step after one of length `par.dt` whose error norm
+		/// was `err`, with a method of order `order` (see `Param::atol`). If the step is
+		/// accepted (`err` at most 1), with a PI controller (which also remembers `err`),
+		/// growing at most 5 times, or not at all right after a rejection (`rejected`);
+		/// if not, shrinking it at most 5 times, to take the step again.
+		/// </summary>
+		double control(double err, int order, bool rejected);
+
+		/// <summary>
+		/// Prepare the chosen engine (e.g., build the tree) and the lists of contacts over `tab`.
+		/// </summary>
+		/// <param name="forces">Whether there is a pair force at all</param>
+		/// <param name="engines">Whether to prepare the engine, or only the contacts
+		/// (for what always sums directly, like `Scheme::hermite`)</param>
+		void prepare(bool forces, bool engines = true);
+
+		/// <summary>
+		/// Run `body` over the indices [0, n) on `workers` if there are any,
+		/// or else on the calling thread (as worker 0).
+		/// </summary>
+		void parallel(int n, pool::Pool::Body const& body) const;
+
+		/// <summary>
+		/// Count the workers that `parallel` may use.
+		/// </summary>
+		int concurrency() const { return workers ? workers->size() : 1; }
+
+		/// <summary>
+		/// Add the wall time (s) from construction to destruction to `total`,
+		/// less what has been added to `except` (if any) meanwhile.
+		/// </summary>
+		class Lap
+		{
+			double& total;
+			double const* except;
+			double before;
+			std::chrono::steady_clock::time_point start;
+		public:
+			Lap(double& total, double const* except = nullptr)
+				: total(total), except(except), before(except ? *except : 0), start(std::chrono::steady_clock::now()) {}
+			~Lap()
+			{
+				std::chrono::duration<double> const d = std::chrono::steady_clock::now() - start;
+				total += d.count() - (except ? *except - before : 0);
+			}
+		};
 	};
 }
@@ -0,0 +1,251 @@
+#include "Fmm.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+using namespace fmm;
+
+namespace
+{
+	/// <summary>
+	/// Constant coefficients of the expansions.
+	/// </summary>
+	struct Coefficients
+	{
+		/// <summary>
+		/// a(j) = (2j choose j) / 4^j, the coefficients of the series of (1 - x)^(-1/2).
+		/// </summary>
+		double a[Fmm::max_order + 1];
+		/// <summary>
+		/// g(j, n) = (-j - 1/2 choose n), the coefficients of the series of (1 + x)^(-j-1/2).
+		/// </summary>
+		double g[Fmm::max_order + 1][Fmm::max_order + 1];
+		/// <summary>
+		/// Binomial coefficients (n choose k).
+		/// </summary>
+		double binom[Fmm::max_order + 1][Fmm::max_order + 1];
+
+		Coefficients()
+		{
+			int constexpr P = Fmm::max_order;
+			a[0] = 1;
+			for (int j = 1; j <= P; j++) a[j] = a[j - 1] * (2 * j - 1) / (2 * j);
+			for (int j = 0; j <= P; j++)
+			{
+				g[j][0] = 1;
+				for (int n = 1; n <= P; n++) g[j][n] = g[j][n - 1] * (-(j + .5) - (n - 1)) / n;
+			}
+			for (int n = 0; n <= P; n++)
+			{
+				binom[n][0] = 1;
+				for (int k = 1; k <= P; k++) binom[n][k] = k > n ? 0 : binom[n][k - 1] * (n - k + 1) / k;
+			}
+		}
+	};
+
+	Coefficients const& coefficients()
+	{
+		static Coefficients const co;
+		return co;
+	}
+}
+
+void Fmm::build()
+{
+	order = std::max(1, std::min(order, max_order));
+	// (The tree itself is walked where the expansions can't be trusted; see `field`.)
+	quad.theta = theta, quad.G = G;
+	quad.build();
+	auto const& cells = quad.cells();
+	auto const& bodies = quad.bodies;
+	auto const& co = coefficients();
+	int const p = order, T = terms(), n = (int)cells.size();
+	ms.assign((size_t)n * T, 0);
+	ls.assign((size_t)n * T, 0);
+	leaf.assign(bodies.size(), -1);
+	reach.assign(n, std::numeric_limits<double>::infinity());
+	if (!n) return;
+
+	// Upward pass: moments of the leaves (P2M), then of the parents (M2M).
+	// Children always come after their parents in `cells`.
+	C pw[max_order + 1], pwb[max_order + 1], tmp[(max_order + 1) * (max_order + 1)];
+	for (int k = n - 1; k >= 0; k--)
+	{
+		tree::Node const& nd = cells[k];
+		C* M = &ms[(size_t)k * T];
+		if (nd.child < 0)
+		{
+			for (int b = nd.begin; b < nd.end; b++)
+			{
+				leaf[b] = k;
+				C const w = bodies[b].z - nd.com;
+				pw[0] = bodies[b].m, pwb[0] = 1;
+				for (int j = 1; j <= p; j++) pw[j] = pw[j - 1] * w, pwb[j] = pwb[j - 1] * conj(w);
+				for (int j = 0; j <= p; j++)
+					for (int l = 0; j + l <= p; l++)
+						M[at(j, l)] += pw[j] * pwb[l];
+			}
+			continue;
+		}
+		for (int c = 0; c < 4; c++)
+		{
+			tree::Node const& ch = cells[nd.child + c];
+			if (ch.end == ch.begin) continue;
+			C const* Mc = &ms[(size_t)(nd.child + c) * T];
+			C const d = ch.com - nd.com;
+			pw[0] = pwb[0] = 1;
+			for (int j = 1; j <= p; j++) pw[j] = pw[j - 1] * d, pwb[j] = pwb[j - 1] * conj(d);
+			// Shift in the powers of w, then of conj(w).
+			for (int j = 0; j <= p; j++)
+				for (int l = 0; j + l <= p; l++)
+				{
+					C z;
+					for (int a = 0; a <= j; a++) z += co.binom[j][a] * pw[j - a] * Mc[at(a, l)];
+					tmp[j * (max_order + 1) + l] = z;
+				}
+			for (int j = 0; j <= p; j++)
+				for (int l = 0; j + l <= p; l++)
+				{
+					C z;
+					for (int b = 0; b <= l; b++) z += co.binom[l][b] * pwb[l - b] * tmp[j * (max_order + 1) + b];
+					M[at(j, l)] += z;
+				}
+		}
+	}
+
+	// Dual traversal: find the pairs of cells that interact through
+	// the expansions (M2L), and the pairs of leaves that must be summed directly.
+	std::vector<std::pair<int, int>> pairs, stack;
+	stack.emplace_back(0, 0);
+	while (!stack.empty())
+	{
+		int const t = stack.back().first, s = stack.back().second;
+		stack.pop_back();
+		tree::Node const& nt = cells[t];
+		tree::Node const& ns = cells[s];
+		if (nt.end == nt.begin || ns.end == ns.begin) continue;
+		double const d = abs(nt.com - ns.com), R = nt.bmax + ns.bmax;
+		if (t != s && R < theta * d && d - R > nt.rmax + ns.rmax)
+		{
+			translate(s, t);
+			reach[t] = std::min(reach[t], d - ns.bmax - ns.rmax);
+		}
+		else if (nt.child < 0 && ns.child < 0)
+			pairs.emplace_back(t, s);
+		else if (ns.child < 0 || (nt.child >= 0 && nt.bmax >= ns.bmax))
+			for (int c = 0; c < 4; c++) stack.emplace_back(nt.child + c, s);
+		else
+			for (int c = 0; c < 4; c++) stack.emplace_back(t, ns.child + c);
+	}
+	near_begin.assign(n + 1, 0);
+	for (auto const& ts : pairs) near_begin[ts.first + 1]++;
+	for (int k = 0; k < n; k++) near_begin[k + 1] += near_begin[k];
+	near_list.resize(pairs.size());
+	{
+		std::vector<int> fill(near_begin.begin(), near_begin.end() - 1);
+		for (auto const& ts : pairs) near_list[fill[ts.first]++] = ts.second;
+	}
+
+	// Downward pass: shift the local expansions of the parents to the children (L2L).
+	for (int k = 0; k < n; k++)
+	{
+		tree::Node const& nd = cells[k];
+		if (nd.child < 0) continue;
+		C const* L = &ls[(size_t)k * T];
+		for (int c = 0; c < 4; c++)
+		{
+			tree::Node const& ch = cells[nd.child + c];
+			if (ch.end == ch.begin) continue;
+			C* Lc = &ls[(size_t)(nd.child + c) * T];
+			C const e = ch.com - nd.com;
+			reach[nd.child + c] = std::min(reach[nd.child + c], reach[k] - abs(e));
+			pw[0] = pwb[0] = 1;
+			for (int j = 1; j <= p; j++) pw[j] = pw[j - 1] * e, pwb[j] = pwb[j - 1] * conj(e);
+			for (int a = 0; a <= p; a++)
+				for (int m = 0; a + m <= p; m++)
+				{
+					C z;
+					for (int j = a; j + m <= p; j++) z += co.binom[j][a] * pw[j - a] * L[at(j, m)];
+					tmp[a * (max_order + 1) + m] = z;
+				}
+			for (int a = 0; a <= p; a++)
+				for (int b = 0; a + b <= p; b++)
+				{
+					C z;
+					for (int m = b; a + m <= p; m++) z += co.binom[m][b] * pwb[m - b] * tmp[a * (max_order + 1) + m];
+					Lc[at(a, b)] += z;
+				}
+		}
+	}
+}
+
+void Fmm::translate(int s, int t)
+{
+	auto const& cells = quad.cells();
+	auto const& co = coefficients();
+	int const p = order, T = terms();
+	int constexpr W = max_order + 1;
+	C const* M = &ms[(size_t)s * T];
+	C* L = &ls[(size_t)t * T];
+
+	// Rotate both coordinate systems so that the displacement D between
+	// the centers (source to target) lies on the positive real axis. Then all
+	// powers of D are real, which makes the re-expansion cheaper.
+	C const D = cells[t].com - cells[s].com;
+	double const rho = abs(D);
+	C const u = D / rho;
+	C up[W];
+	double ir[2 * W];
+	up[0] = 1, ir[0] = 1;
+	for (int k = 1; k <= p; k++) up[k] = up[k - 1] * u;
+	for (int k = 1; k <= 2 * p + 1; k++) ir[k] = ir[k - 1] / rho;
+
+	// A(n, j) = a(j) g(j, n) rho^(-j-n).
+	double A[W * W];
+	for (int nn = 0; nn <= p; nn++)
+		for (int j = 0; j <= p; j++)
+			A[nn * W + j] = co.a[j] * co.g[j][nn] * ir[j + nn];
+
+	// Rotated moments: M(j, k) conj(u)^j u^k.
+	C R[W * (W + 1) / 2];
+	for (int j = 0; j <= p; j++)
+		for (int k = 0; j + k <= p; k++)
+			R[at(j, k)] = M[at(j, k)] * (j > k ? conj(up[j - k]) : up[k - j]);
+
+	// Since the potential is real, L(m, n) = conj(L(n, m)); only n &lt;= m is computed.
+	// X(n, k) = sum over j of A(n, j) R(j, k).
+	C X[W * W];
+	for (int nn = 0; 2 * nn <= p; nn++)
+		for (int k = 0; k <= p; k++)
+		{
+			C z;
+			for (int j = 0; j + k <= p; j++) z += A[nn * W + j] * R[at(j, k)];
+			X[nn * W + k] = z;
+		}
+	// Rotated L(n, m) = 1/rho sum over k of A(m, k) X(n, k); then rotate it back.
+	for (int nn = 0; 2 * nn <= p; nn++)
+		for (int m = nn; nn + m <= p; m++)
+		{
+			C z;
+			for (int k = 0; k <= p; k++) z += A[m * W + k] * X[nn * W + k];
+			C const l = ir[1] * z * up[m - nn];
+			L[at(nn, m)] += l;
+			if (m != nn) L[at(m, nn)] += conj(l);
+		}
+}
+
+C Fmm::evaluate(int t, C const& z) const
+{
+	int const p = order, T = terms();
+	C const* L = &ls[(size_t)t * T];
+	C const e = z - quad.cells()[t].com;
+	C pw[max_order + 1], pwb[max_order + 1];
+	pw[0] = pwb[0] = 1;
+	for (int j = 1; j <= p; j++) pw[j] = pw[j - 1] * e, pwb[j] = pwb[j - 1] * conj(e);
+	// 2 d/d(conj z) of sum L(n, m) e^n conj(e)^m.
+	C a;
+	for (int nn = 0; nn < p; nn++)
+		for (int m = 1; nn + m <= p; m++)
+			a += (double)m * L[at(nn, m)] * pw[nn] * pwb[m - 1];
+	return 2 * G * a;
+}
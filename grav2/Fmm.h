@@ -0,0 +1,168 @@
+#pragma once
+#include "Include.h"
+#include <algorithm>
+#include <vector>
+#include "Tree.h"
+
+/// <summary>
+/// Fast multipole method (FMM) for the inverse-square law in the plane.
+///
+/// Unlike the logarithmic potential of "true" 2D gravity, the potential 1/|z|
+/// is not the real part of an analytic function, so the usual Laurent series
+/// in z alone do not apply. Instead, expand in the powers of both z and conj(z):
+///
+///     1/|z - w| = sum a(j) a(k) w^j conj(w)^k z^(-j-1/2) conj(z)^(-k-1/2),
+///
+/// where a(j) = (2j choose j) / 4^j. Truncating at j + k = p (the "order")
+/// gives the multipole expansions (moments M(j, k) = sum m w^j conj(w)^k).
+/// Re-expanding z^(-j-1/2) about a distant center with the binomial
+/// series gives the local expansions (Taylor series in the powers of
+/// both z and conj(z)). The acceleration is then 2 d/d(conj z) of the local series.
+///
+/// The cells come from a Barnes-Hut quadtree, and the interactions are found
+/// by a dual traversal of the tree (two cells interact through their
+/// expansions if they are far apart as seen from either, else the larger
+/// cell is opened). The work is proportional to N.
+///
+/// Cells that are too close to summarize end up as pairs of leaves; the
+/// bodies in those are handed back to the caller one at a time
+/// (so that the close-range behavior, such as the lune integral, is not lost).
+/// </summary>
+namespace fmm
+{
+	/// <summary>
+	/// Fast multipole method over a quadtree.
+	/// </summary>
+	class Fmm
+	{
+	public:
+		/// <summary>
+		/// Largest order of the expansions.
+		/// </summary>
+		static constexpr int max_order = 20;
+
+		/// <summary>
+		/// The underlying tree. Fill in `quad.bodies` before `build`.
+		/// </summary>
+		tree::Tree quad;
+
+		/// <summary>
+		/// Order (p) of the expansions. Higher is more accurate and slower
+		/// (the cost of an interaction is proportional to p^3). See `dyn::Dyn::Param::order`.
+		/// </summary>
+		int order{ 12 };
+
+		/// <summary>
+		/// Separation criterion: two cells interact through their expansions
+		/// if the sum of their radii is less than `theta` times the distance between
+		/// their centers. Smaller is more accurate and slower.
+		/// </summary>
+		double theta{ 0.5 };
+
+		/// <summary>
+		/// Gravitational constant (LLL/T/T/M).
+		/// </summary>
+		double G{ 1 };
+
+		/// <summary>
+		/// Construct the tree and all expansions over `quad.bodies`.
+		/// </summary>
+		void build();
+
+		/// <summary>
+		/// Forget all bodies and expansions, but keep the storage.
+		/// </summary>
+		void clear() { quad.clear(), ms.clear(), ls.clear(), leaf.clear(), near_begin.clear(), near_list.clear(), reach.clear(); }
+
+		/// <summary>
+		/// Decide whether the expansions have been built (and are not empty).
+		/// </summary>
+		bool built() const { return quad.built() && !ls.empty(); }
+
+		/// <summary>
+		/// Compute the acceleration felt at `z` by the particle of original
+		/// index `self` due to all distant cells. For every body that is too close to
+		/// be summarized, call `near(j)` with the original index `j` of
+		/// the body instead (`self` is skipped).
+		///
+		/// `z` is expected to be near the position of `self` at the time of `build`.
+		/// If it's so far that the local expansion of its leaf can't be trusted there
+		/// (see `reach`), the tree is walked from `z` instead (like `tree::Tree::field`).
+		/// </summary>
+		/// <typeparam name="Near">Callable as `void(int j)`</typeparam>
+		/// <param name="self">Original index of the particle</param>
+		/// <param name="z">Position of the particle (L)</param>
+		/// <param name="r">Radius of the particle (L)</param>
+		/// <param name="near">Process to handle individual nearby bodies</param>
+		/// <returns>Acceleration due to distant cells (L/T/T)</returns>
+		template <class Near>
+		C field(int self, C const& z, double r, Near&& near) const;
+
+	private:
+		/// <summary>
+		/// Multipole expansions (moments) and local expansions, about the centers
+		/// of mass of the respective cells. `terms()` coefficients per cell;
+		/// see `at` for the layout.
+		/// </summary>
+		std::vector<C> ms, ls;
+
+		/// <summary>
+		/// Leaf (cell index) of each body by its position in `quad.bodies`.
+		/// </summary>
+		std::vector<int> leaf;
+
+		/// <summary>
+		/// Lists of nearby leaves (compressed rows): the leaves near leaf `k` are
+		/// `near_list[near_begin[k]]` to `near_list[near_begin[k + 1] - 1]`.
+		/// </summary>
+		std::vector<int> near_begin, near_list;
+
+		/// <summary>
+		/// Distance (L) from the center of mass of each cell to the nearest point
+		/// of any disk summarized in its local expansion. The expansion converges
+		/// within that distance.
+		/// </summary>
+		std::vector<double> reach;
+
+		/// <summary>
+		/// Number of coefficients in an expansion.
+		/// </summary>
+		int terms() const { return (order + 1) * (order + 2) / 2; }
+
+		/// <summary>
+		/// Offset of the coefficient of z^j conj(z)^k in an expansion (j + k &lt;= order).
+		/// </summary>
+		static int at(int j, int k) { return (j + k) * (j + k + 1) / 2 + k; }
+
+		/// <summary>
+		/// Add the contribution of the multipole expansion of cell `s`
+		/// to the local expansion of cell `t` (M2L).
+		/// </summary>
+		void translate(int s, int t);
+
+		/// <summary>
+		/// Evaluate the acceleration at `z` due to the local expansion of cell `t` (L2P).
+		/// </summary>
+		C evaluate(int t, C const& z) const;
+	};
+
+	template <class Near>
+	C Fmm::field(int self, C const& z, double r, Near&& near) const
+	{
+		int const me = quad.position(self), t = leaf[me];
+		auto const& bodies = quad.bodies;
+		auto const& cells = quad.cells();
+		// Within the leaf (as at the time of `build`), or well within the reach of
+		// the expansion (by the same criterion as the cells), and not touching any disk in it.
+		double const x = abs(z - cells[t].com);
+		if (!(x <= std::max(cells[t].bmax, theta * reach[t]) && x + r < reach[t]))
+			return quad.field(self, z, r, near);
+		for (int k = near_begin[t]; k < near_begin[t + 1]; k++)
+		{
+			tree::Node const& nd = cells[near_list[k]];
+			for (int b = nd.begin; b < nd.end; b++)
+				if (b != me) near(bodies[b].i);
+		}
+		return evaluate(t, z);
+	}
+}
@@ -1,16 +1,106 @@
 #include "Geo2.h"
+#include <algorithm>
+#include <limits>
 
-double Halton::next()
+double radical_inverse(unsigned b, unsigned long long n)
 {
-	x = d - n;
-	if (x == 1)
-		n = 1, d *= b;
+	double const inv = 1. / b;
+	double x{}, scale = inv;
+	for (; n; n /= b, scale *= inv) x += (double)(n % b) * scale;
+	return x;
+}
+
+LuneTable::LuneTable()
+{
+	for (auto& n : nodes) n.store(std::numeric_limits<double>::quiet_NaN(), std::memory_order_relaxed);
+}
+
+LuneTable const& LuneTable::shared()
+{
+	static LuneTable const table;
+	return table;
+}
+
+void LuneTable::save(double* out) const
+{
+	for (int k = 0; k < count; k++) out[k] = nodes[k].load(std::memory_order_acquire);
+}
+
+void LuneTable::restore(double const* in) const
+{
+	for (int k = 0; k < count; k++)
+	{
+		// (Computed nodes are the same everywhere, so they are never replaced.)
+		double current = nodes[k].load(std::memory_order_relaxed), v = in[k];
+		if (v == v && current != current) nodes[k].compare_exchange_strong(current, v, std::memory_order_release);
+	}
+}
+
+double LuneTable::integrate(double s, double rho, int samples)
+{
+	// (At rho = 0, the logarithms below would be infinite, though
+	// their contributions cancel over all angles.)
+	rho = std::max(rho, 1e-9);
+	// Both are missing the same factor (2 pi / samples).
+	double field{}, area{};
+	for (int k = samples; k > 0; k--)
+	{
+		double const phi = 2 * PI64 * radical_inverse(2, k), cs = cos(phi);
+		// The ray from c = (s, 0) in the direction phi is within the unit circle
+		// for distances between t1 and t2, and outside the right circle beyond rho.
+		double const b = s * cs, disc = b * b - (s * s - 1);
+		if (disc <= 0) continue;
+		double const q = sqrt(disc), t2 = -b + q, t1 = std::max(-b - q, rho);
+		if (t2 <= t1) continue;
+		// Along the ray, the real part of (c - p) / |c - p|^3 dA is -cos(phi) / t dt dphi.
+		field -= cs * log(t2 / t1);
+		area += (t2 * t2 - t1 * t1) / 2;
+	}
+	return area > 0 ? field / area : 0;
+}
+
+double LuneTable::node(int i, int j) const
+{
+	i = std::max(0, std::min(i, size)), j = std::max(0, std::min(j, size));
+	auto& n = nodes[j * (size + 1) + i];
+	double v = n.load(std::memory_order_acquire);
+	if (v == v) return v;
+	// (If two threads get here at once, they compute the same value.)
+	double const t = i / (double)size, u = j / (double)size;
+	// At u = 1, the right circle is infinitely large, and the lune is empty.
+	if (j == size) v = 0;
 	else
 	{
-		y = d / b;
-		while (x <= y)
-			y /= b;
-		n = (b + 1) * y - x;
+		double const rho = u / (1 - u), lo = std::max(0., rho - 1);
+		v = integrate(lo + t * (1 + rho - lo), rho, samples);
+	}
+	n.store(v, std::memory_order_release);
+	return v;
+}
+
+double LuneTable::operator()(double s, double rho) const
+{
+	// If the left circle is within the right circle, the lune is empty.
+	double const lo = std::max(0., rho - 1);
+	if (s <= lo) return 0;
+	double const x = (s - lo) / (1 + rho - lo) * size, y = rho / (1 + rho) * size;
+	int const i = (int)floor(x), j = (int)floor(y);
+	// Catmull-Rom weights of the four nodes around x (or y).
+	auto weights = [](double f, double w[4])
+		{
+			w[0] = ((2 - f) * f - 1) * f / 2;
+			w[1] = ((3 * f - 5) * f * f + 2) / 2;
+			w[2] = ((4 - 3 * f) * f + 1) * f / 2;
+			w[3] = (f - 1) * f * f / 2;
+		};
+	double wx[4], wy[4];
+	weights(x - i, wx), weights(y - j, wy);
+	double v{};
+	for (int b = 0; b < 4; b++)
+	{
+		double row{};
+		for (int a = 0; a < 4; a++) row += wx[a] * node(i - 1 + a, j - 1 + b);
+		v += wy[b] * row;
 	}
-	return n / (double)d;
+	return v;
 }
@@ -1,140 +1,108 @@
 #pragma once
 
 #include "Include.h"
+#include <atomic>
 
 /// <summary>
-/// Generate a Halton sequence (algorithm is due to Wikipedia) of a given base (`b`).
-/// 
-/// To use Halton low-discrepancy sequences to fill up the unit square
-/// in n-space, use successive prime numbers (2, 3, 5, etc.) and
-/// generate x, y, z, etc. coordinates from these individual streams.
+/// Compute the term of index `n` (from 1) of the Halton sequence of base `b`,
+/// which is the radical inverse of `n` in base `b` (the digits of `n` mirrored
+/// about the point), in O(log n) time.
 /// </summary>
-struct Halton
-{
-private:
-	/// <summary>
-	/// Algorithm's working state. This depends on the algorithm itself.
-	/// There are other ways of generating Halton sequences.
-	/// </summary>
-	unsigned n{ 0 }, d{ 1 }, x{}, y{}, b{};
-public:
-	/// <summary>
-	/// Initialize a sequence with the given prime base.
-	/// </summary>
-	/// <param name="b">Base (prime number).</param>
-	Halton(unsigned b) : b(b) {}
-
-	/// <summary>
-	/// Extract a term and advance the internal state.
-	/// </summary>
-	/// <returns>A number in the open interval (0, 1).</returns>
-	double next();
-private:
-	/// <summary>
-	/// Create a default instance in an unspecified (erroneous) state.
-	/// </summary>
-	Halton() : b(0) {}
-
-	// Allow initializing in an array using the no-argument
-	// constructor, which would be "off" to make available
-	// to the anyone else for the risk of construction of an invalid state.
-	friend struct Halton2D;
-};
+/// <param name="b">Base (prime number)</param>
+/// <param name="n">Index, 1 or more</param>
+/// <returns>A number in (0, 1)</returns>
+double radical_inverse(unsigned b, unsigned long long n);
 
 /// <summary>
-/// Using the Halton low-discrepancy sequences,
-/// generates points evenly in the unit square in (0,1) x (0,1).
+/// Tabulated mean field of the inverse-square law over the one-sided lune.
+/// 
+/// Reoriented and scaled so that the left circle is the unit circle at the origin
+/// and the right circle (radius `rho`) is centered at (`s`, 0), take the part of
+/// the left circle outside the right circle (the lune), and average the field
+/// (c - p) / |c - p|^3 toward the center c of the right circle over the points p
+/// of the lune. By symmetry, the average points along the real axis; its
+/// real part is tabulated as a function of (s, rho).
+/// 
+/// In the original coordinate system, with the left radius `lr`, the average
+/// is that value divided by lr^2, rotated toward the right circle.
+/// 
+/// Each node of the table is computed the first time it's needed, and is
+/// then remembered. In polar coordinates about c, the radial part of the integral has
+/// a closed form (a logarithm), so that only the angle is sampled (with the
+/// van der Corput sequence, by index), which is accurate even for small `rho`.
+/// The nodes are independent of the order (and the thread) in which they are computed.
+/// Between the nodes, the table is interpolated with bicubic (Catmull-Rom) splines.
+/// (The average jumps near concentric circles of about equal radii, where
+/// it's therefore less accurate.)
+/// 
+/// Thread safe.
 /// </summary>
-struct Halton2D
+struct LuneTable
 {
 	/// <summary>
-	/// Exposed internal state (Halton low-discrepancy sequences).
+	/// Number of cells of the table in each direction.
 	/// </summary>
-	Halton h[2];
+	static constexpr int size = 64;
 
 	/// <summary>
-	/// Create a valid instance of Halton2D.
+	/// Number of samples (angles) per node.
 	/// </summary>
-	Halton2D() { h[0] = Halton(2), h[1] = Halton(3); }
+	static constexpr int samples = 1 << 12;
 
 	/// <summary>
-	/// Generate a point in the (0,1) x (0,1) square.
+	/// Look up the average field (see `LuneTable`).
 	/// </summary>
-	C next() { return C(h[0].next(), h[1].next()); }
-};
+	/// <param name="s">Distance between the centers over the left radius, less
+	/// than 1 + rho (so that the circles intersect)</param>
+	/// <param name="rho">Right radius over the left radius</param>
+	/// <returns>Real part of the average field, in units of the left radius</returns>
+	double operator()(double s, double rho) const;
 
-/// <summary>
-/// Store a pair of possibly intersecting circles in a reoriented coordinate system,
-/// where the left circle is centered at the origin, and the right circle
-/// has a center on the positive real axis. Here lengths do not change;
-/// only orientation does.
-/// </summary>
-struct CircularIntersection
-{
-private:
 	/// <summary>
-	/// Center of the right circle (x-coordinate);
-	/// Midpoint of the bounding square;
-	/// Radius of the left circle;
-	/// Squared radius of the left circle (and right circle).
+	/// Compute the average field directly (see `LuneTable`).
 	/// </summary>
-	double c{}, lr{}, lrsq{}, rrsq{};
+	/// <param name="s">Distance between the centers over the left radius</param>
+	/// <param name="rho">Right radius over the left radius</param>
+	/// <param name="samples">Number of angles to sample</param>
+	/// <returns>Real part of the average field, or 0 if the lune is empty</returns>
+	static double integrate(double s, double rho, int samples);
 
 	/// <summary>
-	/// Rotation needed to transform the reoriented coordinate system vector
-	/// to the original coordinate system (but without translation).
-	/// 
-	/// "De-rotation."
+	/// Recall the process-wide table.
 	/// </summary>
-	C derot;
+	static LuneTable const& shared();
 
-public:
 	/// <summary>
-	/// Construct data about the (possible) intersection between two circles.
+	/// Number of nodes.
 	/// </summary>
-	/// <param name="c0">Center of the left circle.</param>
-	/// <param name="r0">Radius of the left circle.</param>
-	/// <param name="c1">Center of the right circle.</param>
-	/// <param name="r1">Radius of the right circle.</param>
-	CircularIntersection(C c0, double r0, C c1, double r1)
-		: lr(r0), lrsq(r0* r0), rrsq(r1* r1)
-	{
-		// Translate (geometry) as required.
-		c1 -= c0;
-		// Make a circle centered about (0,0) passing through point c1
-		// and then construct the intersection (c) between this circle
-		// and the positive real axis ray. This represents rotation.
-		c = abs(c1);
-		// Compute the reverse rotation.
-		derot = c1 / c;
-	}
+	static constexpr int count = (size + 1) * (size + 1);
 
 	/// <summary>
-	/// Decide whether the point (reoriented coord.) is in the left circle.
+	/// Copy the nodes to `out` (`count` values; NaN where not yet computed),
+	/// e.g., to save them with a checkpoint.
 	/// </summary>
-	bool left(C const& p) const { return std::norm(p) < lrsq; }
+	void save(double* out) const;
 
 	/// <summary>
-	/// Decide whether the point (reoriented coord.) is in the right circle.
+	/// Adopt the nodes in `in` (as from `save`) that are computed there but not yet here.
 	/// </summary>
-	bool right(C const& p) const { return std::norm(p - c) < rrsq; }
+	void restore(double const* in) const;
 
-	/// <summary>
-	/// Perform a trial, calling the user-defined process `f` that takes in
-	/// the point `p` which is in the reoriented coordinate system.
-	/// </summary>
-	/// <param name="h">A point in the (0,1) x (0,1) square</param>
-	/// <param name="f">A process for which p is in the reoriented coordinate system</param>
-	void monte(C const& h, std::function<void(C const& p)> const& f) const { f(from01(h)); }
+	LuneTable();
+	LuneTable(LuneTable const&) = delete;
+	LuneTable& operator=(LuneTable const&) = delete;
 
+private:
 	/// <summary>
-	/// Transform a point in the (0,1) x (0,1) square to the bounding square.
+	/// Nodes at (t, u) = (i / size, j / size) for 0 &lt;= i, j &lt;= size, where
+	/// u = rho / (1 + rho), and t goes from 0 to 1 as s goes from max(0, rho - 1) to 1 + rho
+	/// (beyond which the lune is empty, or the circles don't intersect),
+	/// row by row (of the same u). NaN if not yet computed.
 	/// </summary>
-	C from01(C const& h) const { return (h - C(.5, .5)) * lr; }
+	mutable std::atomic<double> nodes[count];
 
 	/// <summary>
-	/// Orient the reoriented vector to the original orientation (but the
-	/// left circle will be still at the origin). Essentially, un-rotate.
+	/// Recall (computing it if need be) the node at (i, j), clamped to the table.
 	/// </summary>
-	C unrotate(C const& p) const { return p * derot; }
+	double node(int i, int j) const;
 };
@@ -0,0 +1,77 @@
+#include "Grid.h"
+#include <algorithm>
+
+using namespace grid;
+
+bool Contacts::update(double const* x, double const* y, double const* r, int n)
+{
+	if ((int)x0.size() != n || !built())
+	{
+		build(x, y, r, n);
+		return true;
+	}
+	double d2{};
+	for (int i = 0; i < n; i++)
+	{
+		double const dx = x[i] - x0[i], dy = y[i] - y0[i];
+		d2 = std::max(d2, dx * dx + dy * dy);
+	}
+	drift = sqrt(d2);
+	// Any two disks may have come closer by up to twice the drift.
+	if (!(2 * drift < skin))
+	{
+		build(x, y, r, n);
+		return true;
+	}
+	return false;
+}
+
+void Contacts::build(double const* x, double const* y, double const* r, int n)
+{
+	x0.assign(x, x + n), y0.assign(y, y + n);
+	drift = 0;
+	pairs.clear();
+
+	double rmax{};
+	for (int i = 0; i < n; i++) rmax = std::max(rmax, r[i]);
+	double const h = std::max(2 * rmax + skin, 1e-300);
+
+	// Cell of each disk. (Far away or invalid positions all go to one cell;
+	// the distance test below still rejects them.)
+	std::vector<long long> cx(n), cy(n);
+	auto cell = [=](double v) { double const c = floor(v / h); return std::abs(c) < 1e15 ? (long long)c : 0; };
+	for (int i = 0; i < n; i++) cx[i] = cell(x[i]), cy[i] = cell(y[i]);
+
+	int buckets = 1;
+	while (buckets < 2 * n) buckets *= 2;
+	auto bucket = [=](long long a, long long b)
+		{
+			unsigned long long k = (unsigned long long)a * 0x9E3779B97F4A7C15ull ^ (unsigned long long)b * 0xC2B2AE3D27D4EB4Full;
+			return (int)((k ^ k >> 29) & (unsigned long long)(buckets - 1));
+		};
+	head.assign(buckets, -1), next.assign(n, -1);
+	for (int i = 0; i < n; i++)
+	{
+		int const b = bucket(cx[i], cy[i]);
+		next[i] = head[b], head[b] = i;
+	}
+
+	// Look in the 3 x 3 cells around each disk. (Several cells may share
+	// a bucket; only the disks in the cell in question count.)
+	for (int i = 0; i < n; i++)
+		for (long long a = cx[i] - 1; a <= cx[i] + 1; a++)
+			for (long long b = cy[i] - 1; b <= cy[i] + 1; b++)
+				for (int j = head[bucket(a, b)]; j >= 0; j = next[j])
+				{
+					if (j <= i || cx[j] != a || cy[j] != b) continue;
+					double const dx = x[j] - x[i], dy = y[j] - y[i], reach = r[i] + r[j] + skin;
+					if (dx * dx + dy * dy < reach * reach) pairs.emplace_back(i, j);
+				}
+
+	begin.assign(n + 1, 0);
+	for (auto const& p : pairs) begin[p.first + 1]++, begin[p.second + 1]++;
+	for (int i = 0; i < n; i++) begin[i + 1] += begin[i];
+	list.resize(begin[n]);
+	std::vector<int> fill(begin.begin(), begin.end() - 1);
+	for (auto const& p : pairs) list[fill[p.first]++] = p.second, list[fill[p.second]++] = p.first;
+}
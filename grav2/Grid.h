@@ -0,0 +1,117 @@
+#pragma once
+#include "Include.h"
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Broad phase of the detection of overlapping disks.
+///
+/// The plane is divided into a uniform grid of square cells, each as wide as
+/// the largest possible reach (twice the largest radius, plus the skin), so that
+/// any two disks that come within the skin of each other are in the same
+/// or in adjacent cells. The cells are found by hashing. From these, Verlet
+/// lists are made: for each disk, the other disks within the skin of it.
+/// The lists are kept as long as no disk has moved so far (more than half
+/// the skin) that a pair not on the lists could have come to overlap.
+///
+/// With disks of similar sizes, the work is proportional to N.
+/// </summary>
+namespace grid
+{
+	/// <summary>
+	/// Decide whether two disks overlap, given the displacement (dx, dy) between
+	/// their centers and the sum of their radii (`reach`).
+	/// 
+	/// Everything that must agree on which pairs overlap (see also Kernel.h)
+	/// computes it this way, in this order, without fused multiply-adds.
+	/// </summary>
+	inline bool overlap(double dx, double dy, double reach) { return dx * dx + dy * dy < reach * reach; }
+
+	/// <summary>
+	/// Verlet lists of candidate overlapping pairs.
+	/// </summary>
+	class Contacts
+	{
+	public:
+		/// <summary>
+		/// Margin (L) beyond the sum of the radii within which two disks are listed.
+		/// Larger means that the lists can be kept for longer, but are longer.
+		/// </summary>
+		double skin{ 1 };
+
+		/// <summary>
+		/// Bring the lists up to date for the disks at (x[i], y[i]) of radii r[i].
+		/// Make them anew if there's a different number of disks, or if the disks have
+		/// moved too far since the lists were made.
+		/// </summary>
+		/// <returns>Whether the lists were made anew</returns>
+		bool update(double const* x, double const* y, double const* r, int n);
+
+		/// <summary>
+		/// Forget all lists, so that the next `update` makes them anew.
+		/// </summary>
+		void clear() { x0.clear(), y0.clear(), pairs.clear(), begin.clear(), list.clear(), drift = 0; }
+
+		/// <summary>
+		/// Decide whether the lists have been made (and are not empty).
+		/// </summary>
+		bool built() const { return !begin.empty(); }
+
+		/// <summary>
+		/// Decide whether the list of the disk `i` is certain to contain every disk
+		/// that overlaps it if it were at `z` (and the others where they were at the last `update`).
+		/// </summary>
+		bool covers(int i, C const& z) const
+		{
+			double const dx = z.real() - x0[i], dy = z.imag() - y0[i];
+			return sqrt(dx * dx + dy * dy) + drift < skin;
+		}
+
+		/// <summary>
+		/// Candidates to overlap the disk `i`: `near(i)[0]` to `near(i)[count(i) - 1]`.
+		/// </summary>
+		int const* near(int i) const { return list.data() + begin[i]; }
+
+		/// <summary>
+		/// Count the candidates to overlap the disk `i`.
+		/// </summary>
+		int count(int i) const { return begin[i + 1] - begin[i]; }
+
+		/// <summary>
+		/// All candidate pairs (i, j), i &lt; j, each once.
+		/// </summary>
+		std::vector<std::pair<int, int>> const& all() const { return pairs; }
+
+	private:
+		/// <summary>
+		/// Positions at the time the lists were made (L).
+		/// </summary>
+		std::vector<double> x0, y0;
+
+		/// <summary>
+		/// Largest distance that any disk has moved since then (L).
+		/// </summary>
+		double drift{};
+
+		/// <summary>
+		/// Candidate pairs, each once.
+		/// </summary>
+		std::vector<std::pair<int, int>> pairs;
+
+		/// <summary>
+		/// Lists of candidates of each disk (compressed rows; both ways).
+		/// </summary>
+		std::vector<int> begin, list;
+
+		/// <summary>
+		/// Cells: first disk in each bucket of the hash table (or -1),
+		/// next disk in the same bucket (or -1).
+		/// </summary>
+		std::vector<int> head, next;
+
+		/// <summary>
+		/// Make the lists anew.
+		/// </summary>
+		void build(double const* x, double const* y, double const* r, int n);
+	};
+}
@@ -0,0 +1,406 @@
+#include "Include.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Diagnostics.h"
+#include "Drivers.h"
+#include "Raster.h"
+#include "Trajectory.h"
+
+// Headless runner: simulate a scenario without a window, for a number of steps or
+// an amount of simulated time, and report the throughput as a line of JSON.
+//
+//     grav2-headless [--scene make|set1] [--n N] [--seed S]
+//         [--steps K | --time T] [--engine direct|tree|multipole]
+//         [--dt X] [--theta X] [--order P] [--skin L] [--blocks] [--mixed] [--threads W]
+//         [--scheme independent|coupled|leapfrog|forest-ruth|hermite] [--eta X] [--atol X] [--rtol X] [--merge X]
+//         [--load PATH] [--save PATH] [--trajectory PATH [--every K | --interval T]] [--monitor K]
+//         [--render PATTERN [--size WxH] [--zoom X]]
+//
+// With --load, the run resumes from a checkpoint (see Dyn::save) instead of
+// making the scenario; its parameters are then those of the checkpoint, unless given.
+// With --save, a checkpoint is written at the end. With --trajectory, every K-th
+// state (or the state at every multiple of T in simulated time, interpolated) is
+// streamed to a trajectory file (see Trajectory.h). With --monitor, the
+// energy and momenta are sampled every K steps (see Diagnostics.h), and the
+// relative drift of the energy is reported. With --render, frames are drawn
+// as the window would (see Raster.h) at the same times as the trajectory, to
+// PATTERN with %d (or e.g. %05d) for the number of the frame: PNG if it ends
+// in .png, and raw RGBA otherwise (all in one file, if there's no %d).
+// Pair interactions are counted as direct summation would do them
+// (N - 1 per acceleration of a particle), whatever the engine.
+
+using namespace dyn;
+
+namespace
+{
+	/// <summary>
+	/// Options of the command line.
+	/// </summary>
+	struct Options
+	{
+		std::string scene{ "make" };
+		int n{ 125 };
+		unsigned seed{ 1 };
+		long long steps{ 1000 };
+		/// <summary>
+		/// Simulated time (T) to run for instead of `steps`, if positive.
+		/// </summary>
+		double time{};
+		Dyn::Engine engine{ Dyn::Engine::direct };
+		/// <summary>
+		/// Time step (T) to start with, if positive.
+		/// </summary>
+		double dt{};
+		double theta{ 0.5 };
+		int order{ 12 };
+		double skin{ 1 };
+		bool blocks{};
+		/// <summary>
+		/// Whether to sum in mixed precision (see `Dyn::Precision`).
+		/// </summary>
+		bool mixed{};
+		/// <summary>
+		/// How the particles go through the stages of the integrator.
+		/// </summary>
+		Dyn::Scheme scheme{ Dyn::Scheme::independent };
+		/// <summary>
+		/// Accuracy of the time steps of `Dyn::Scheme::hermite`, if positive (see `Dyn::Param::eta`).
+		/// </summary>
+		double eta{};
+		/// <summary>
+		/// Tolerances of the error control, if not negative (see `Dyn::Param::atol`;
+		/// an `atol` of 0 goes back to the judges).
+		/// </summary>
+		double atol{ -1 }, rtol{ -1 };
+		/// <summary>
+		/// Depth of overlap from which particles merge, if not negative (see `Dyn::Param::merge`).
+		/// </summary>
+		double merge{ -1 };
+		/// <summary>
+		/// Number of workers, or 0 for all hardware threads.
+		/// </summary>
+		int threads{};
+		/// <summary>
+		/// Checkpoints to resume from and to write at the end (if not empty).
+		/// </summary>
+		std::string load, save;
+		/// <summary>
+		/// Trajectory to write (if not empty), every this many steps (or every `interval` of simulated time, if positive).
+		/// </summary>
+		std::string trajectory;
+		int every{ 1 };
+		double interval{};
+		/// <summary>
+		/// Sample the conserved quantities every this many steps (if positive).
+		/// </summary>
+		int monitor{};
+		/// <summary>
+		/// Frames to draw (if not empty): the pattern of their paths, and how (see `raster::Options`).
+		/// </summary>
+		std::string render;
+		raster::Options frame;
+		/// <summary>
+		/// Whether the parameters of the simulation were given (and not
+		/// to be taken from the checkpoint).
+		/// </summary>
+		bool engine_given{}, blocks_given{}, mixed_given{}, scheme_given{};
+	};
+
+	void usage(char const* program)
+	{
+		std::fprintf(stderr,
+			"usage: %s [--scene make|set1] [--n N] [--seed S] [--steps K | --time T]\n"
+			"    [--engine direct|tree|multipole] [--dt X] [--theta X] [--order P] [--skin L]\n"
+			"    [--blocks] [--mixed] [--threads W]\n"
+			"    [--scheme independent|coupled|leapfrog|forest-ruth|hermite] [--eta X]\n"
+			"    [--atol X] [--rtol X] [--merge X] [--load PATH] [--save PATH]\n"
+			"    [--trajectory PATH [--every K | --interval T]] [--monitor K]\n"
+			"    [--render PATTERN [--size WxH] [--zoom X]]\n", program);
+		std::exit(2);
+	}
+
+	bool png(std::string const& path)
+	{
+		return path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+	}
+
+	/// <summary>
+	/// Whether `pattern` has one conversion (for the number of the frame), and it's %d or %0Nd.
+	/// </summary>
+	bool numbered(std::string const& pattern)
+	{
+		size_t const k = pattern.find('%');
+		if (k == std::string::npos) return false;
+		size_t const d = pattern.find_first_not_of("0123456789", k + 1);
+		return d != std::string::npos && pattern[d] == 'd' && pattern.find('%', d) == std::string::npos;
+	}
+
+	/// <summary>
+	/// Draws frames of the simulation, at the times the trajectory would be written (see `traj::Writer::record`).
+	/// </summary>
+	class Frames
+	{
+	public:
+		Frames(Options const& o, std::shared_ptr<pool::Pool> workers)
+			: pattern(o.render), every(o.every), interval(o.interval)
+		{
+			renderer.options = o.frame;
+			renderer.workers = std::move(workers);
+			if (!numbered(pattern)) raw = std::fopen(pattern.c_str(), "wb"), ok = raw != nullptr;
+		}
+
+		~Frames() { if (raw) std::fclose(raw); }
+
+		/// <summary>
+		/// Draw the frames due after the step just taken.
+		/// </summary>
+		void record(Dyn const& dyn)
+		{
+			if (interval > 0)
+			{
+				if (!calls++) next = (long long)std::ceil(dyn.began() / interval - 1e-9);
+				while (next * interval <= dyn.stats.time + 1e-9 * interval)
+					snapshot.capture(dyn, next++ * interval), draw();
+				return;
+			}
+			if (calls++ % std::max(1, every)) return;
+			snapshot.capture(dyn), draw();
+		}
+
+		long long count() const { return drawn; }
+		bool good() const { return ok; }
+
+	private:
+		void draw()
+		{
+			if (!ok) return;
+			renderer.render(snapshot, image);
+			if (raw) ok = raster::append_raw(raw, image);
+			else
+			{
+				char path[4096];
+				std::snprintf(path, sizeof(path), pattern.c_str(), (int)drawn);
+				if (png(pattern)) ok = raster::save_png(path, image);
+				else if (std::FILE* const f = std::fopen(path, "wb"))
+				{
+					ok = raster::append_raw(f, image);
+					ok = std::fclose(f) == 0 && ok;
+				}
+				else ok = false;
+			}
+			drawn += ok;
+		}
+
+		std::string pattern;
+		int every;
+		double interval;
+		/// <summary>
+		/// File of all the frames, if they're not numbered.
+		/// </summary>
+		std::FILE* raw{};
+		bool ok{ true };
+		long long calls{}, next{}, drawn{};
+		raster::Renderer renderer;
+		raster::Image image;
+		snap::Snapshot snapshot;
+	};
+
+	Options parse(int argc, char** argv)
+	{
+		Options o;
+		for (int k = 1; k < argc; k++)
+		{
+			std::string const key = argv[k];
+			auto value = [&]() -> char const* { if (k + 1 >= argc) usage(argv[0]); return argv[++k]; };
+			if (key == "--scene") o.scene = value();
+			else if (key == "--n") o.n = std::atoi(value());
+			else if (key == "--seed") o.seed = (unsigned)std::strtoul(value(), nullptr, 10);
+			else if (key == "--steps") o.steps = std::atoll(value()), o.time = 0;
+			else if (key == "--time") o.time = std::atof(value());
+			else if (key == "--dt") o.dt = std::atof(value());
+			else if (key == "--eta") o.eta = std::atof(value());
+			else if (key == "--atol") o.atol = std::atof(value());
+			else if (key == "--rtol") o.rtol = std::atof(value());
+			else if (key == "--merge") o.merge = std::atof(value());
+			else if (key == "--theta") o.theta = std::atof(value());
+			else if (key == "--order") o.order = std::atoi(value());
+			else if (key == "--skin") o.skin = std::atof(value());
+			else if (key == "--blocks") o.blocks = o.blocks_given = true;
+			else if (key == "--mixed") o.mixed = o.mixed_given = true;
+			else if (key == "--threads") o.threads = std::atoi(value());
+			else if (key == "--load") o.load = value();
+			else if (key == "--save") o.save = value();
+			else if (key == "--trajectory") o.trajectory = value();
+			else if (key == "--every") o.every = std::atoi(value());
+			else if (key == "--interval") o.interval = std::atof(value());
+			else if (key == "--monitor") o.monitor = std::atoi(value());
+			else if (key == "--render") o.render = value();
+			else if (key == "--zoom") o.frame.zoom = std::atof(value());
+			else if (key == "--size")
+			{
+				if (std::sscanf(value(), "%dx%d", &o.frame.width, &o.frame.height) != 2) usage(argv[0]);
+			}
+			else if (key == "--engine")
+			{
+				std::string const e = value();
+				o.engine_given = true;
+				if (e == "direct") o.engine = Dyn::Engine::direct;
+				else if (e == "tree") o.engine = Dyn::Engine::tree;
+				else if (e == "multipole") o.engine = Dyn::Engine::multipole;
+				else usage(argv[0]);
+			}
+			else if (key == "--scheme")
+			{
+				std::string const e = value();
+				o.scheme_given = true;
+				if (e == "independent") o.scheme = Dyn::Scheme::independent;
+				else if (e == "coupled") o.scheme = Dyn::Scheme::coupled;
+				else if (e == "leapfrog") o.scheme = Dyn::Scheme::leapfrog;
+				else if (e == "forest-ruth") o.scheme = Dyn::Scheme::forest_ruth;
+				else if (e == "hermite") o.scheme = Dyn::Scheme::hermite;
+				else usage(argv[0]);
+			}
+			else usage(argv[0]);
+		}
+		if (o.scene != "make" && o.scene != "set1") usage(argv[0]);
+		if (o.n < 1) usage(argv[0]);
+		if (o.frame.width < 1 || o.frame.height < 1 || !(o.frame.zoom > 0)) usage(argv[0]);
+		if (!o.render.empty() && !numbered(o.render) && (o.render.find('%') != std::string::npos || png(o.render)))
+			usage(argv[0]);
+		return o;
+	}
+
+	double since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options const o = parse(argc, argv);
+
+	auto t = std::chrono::steady_clock::now();
+	Sim dyn = blank();
+	if (o.load.empty())
+	{
+		dyn = o.scene == "set1" ? make_set1() : make(o.n, o.seed);
+		dyn.par.theta = o.theta, dyn.par.order = o.order, dyn.par.skin = o.skin;
+	}
+	else if (!dyn.load(o.load.c_str()))
+	{
+		std::fprintf(stderr, "cannot load the checkpoint %s\n", o.load.c_str());
+		return 1;
+	}
+	if (o.load.empty() || o.engine_given) dyn.par.engine = o.engine;
+	if (o.load.empty() || o.blocks_given) dyn.par.blocks = o.blocks;
+	if (o.load.empty() || o.mixed_given) dyn.par.precision = o.mixed ? Dyn::Precision::mixed : Dyn::Precision::full;
+	if (o.load.empty() || o.scheme_given) dyn.par.scheme = o.scheme;
+	if (o.dt > 0) dyn.par.dt = o.dt;
+	if (o.eta > 0) dyn.par.eta = o.eta;
+	if (o.atol >= 0) dyn.par.atol = o.atol;
+	if (o.rtol >= 0) dyn.par.rtol = o.rtol;
+	if (o.merge >= 0) dyn.par.merge = o.merge;
+	dyn.workers = o.threads ? std::make_shared<pool::Pool>(o.threads) : pool::Pool::shared();
+	double const setup = since(t);
+	// (The setup's own work is left out of the rates below.)
+	Dyn::Stats const before = dyn.stats;
+
+	std::unique_ptr<traj::Writer> writer;
+	if (!o.trajectory.empty())
+	{
+		traj::Options options;
+		options.every = o.every, options.interval = o.interval;
+		writer.reset(new traj::Writer(o.trajectory.c_str(), options));
+	}
+
+	std::unique_ptr<Frames> frames;
+	if (!o.render.empty()) frames.reset(new Frames(o, dyn.workers));
+
+	diag::Monitor monitor;
+	monitor.every = o.monitor, monitor.theta = dyn.par.theta;
+	if (o.monitor > 0) monitor.record(dyn);
+
+	double simulated{}, pairs{}, bias{}, record{}, render{}, diagnose{};
+	long long steps{};
+	t = std::chrono::steady_clock::now();
+	while (o.time > 0 ? simulated < o.time : steps < o.steps)
+	{
+		long long const evaluated = dyn.stats.evaluations;
+		dyn.step();
+		// (A step may be shorter than `par.dt` was, if rejected; see `Dyn::control`.)
+		simulated = dyn.stats.time - before.time, steps++;
+		// (Of the particles left after merging, if any.)
+		pairs += (double)(dyn.stats.evaluations - evaluated) * (dyn.n() - 1);
+		auto const b = std::chrono::steady_clock::now();
+		dyn.bias();
+		bias += since(b);
+		if (writer)
+		{
+			auto const r = std::chrono::steady_clock::now();
+			writer->record(dyn);
+			record += since(r);
+		}
+		if (frames)
+		{
+			auto const r = std::chrono::steady_clock::now();
+			frames->record(dyn);
+			render += since(r);
+		}
+		if (o.monitor > 0)
+		{
+			auto const d = std::chrono::steady_clock::now();
+			monitor.record(dyn);
+			diagnose += since(d);
+		}
+	}
+	double const wall = since(t);
+	long long const dropped = writer ? writer->dropped() : 0;
+	if (writer && !writer->good()) std::fprintf(stderr, "cannot write the trajectory %s\n", o.trajectory.c_str());
+	writer.reset();
+	long long const drawn = frames ? frames->count() : 0;
+	if (frames && !frames->good()) std::fprintf(stderr, "cannot write the frames %s\n", o.render.c_str());
+	frames.reset();
+
+	double checkpoint{};
+	if (!o.save.empty())
+	{
+		auto const c = std::chrono::steady_clock::now();
+		if (!dyn.save(o.save.c_str()))
+		{
+			std::fprintf(stderr, "cannot save the checkpoint %s\n", o.save.c_str());
+			return 1;
+		}
+		checkpoint = since(c);
+	}
+
+	Dyn::Stats const& s = dyn.stats;
+	char const* const schemes[] = { "independent", "coupled", "leapfrog", "forest-ruth", "hermite" };
+	long long const evaluations = s.evaluations - before.evaluations;
+	std::printf(
+		"{\"scene\": \"%s\", \"n\": %d, \"engine\": \"%s\", \"blocks\": %s, \"precision\": \"%s\", \"scheme\": \"%s\", \"workers\": %d, "
+		"\"steps\": %lld, \"simulated\": %.9g, \"dt\": %.9g, "
+		"\"evaluations\": %lld, \"retries\": %lld, \"merges\": %lld, \"pairs\": %.9g, "
+		"\"steps_per_s\": %.9g, \"pairs_per_s\": %.9g, "
+		"\"wall\": {\"setup\": %.9g, \"prepare\": %.9g, \"integrate\": %.9g, \"bias\": %.9g, \"record\": %.9g, \"render\": %.9g, \"diagnostics\": %.9g, \"total\": %.9g, \"checkpoint\": %.9g}, "
+		"\"dropped\": %lld, \"frames\": %lld, "
+		"\"kinetic_energy\": %.9g, \"samples\": %d, \"energy_drift\": %.9g, \"worst_drift\": %.9g}\n",
+		o.load.empty() ? o.scene.c_str() : "checkpoint", dyn.n(),
+		dyn.par.engine == Dyn::Engine::direct ? "direct" : dyn.par.engine == Dyn::Engine::tree ? "tree" : "multipole",
+		dyn.par.blocks ? "true" : "false",
+		dyn.par.precision == Dyn::Precision::mixed ? "mixed" : "full",
+		schemes[(int)dyn.par.scheme], dyn.workers->size(),
+		steps, simulated, dyn.par.dt,
+		evaluations, s.retries - before.retries, s.merges - before.merges, pairs,
+		steps / wall, pairs / wall,
+		setup, s.prepare - before.prepare, s.integrate - before.integrate, bias, record, render, diagnose, wall, checkpoint, dropped, drawn,
+		kinetic_energy(dyn), (int)monitor.series().size(),
+		monitor.series().empty() ? 0. : monitor.series().back().drift, monitor.worst());
+	return 0;
+}
@@ -0,0 +1,492 @@
+#include "Kernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERNEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each kernel for its own instruction set (and only
+// that kernel), so the rest of the program still runs on any processor.
+// MSVC accepts the intrinsics anyway.
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+using namespace kernel;
+
+namespace
+{
+	/// <summary>
+	/// Squared distances outside of [tiny, huge] (or NaN) are deferred. The
+	/// reciprocal square root of anything in between is estimated well in single precision.
+	/// </summary>
+	double constexpr tiny = 1e-30, huge = 1e30;
+
+	/// <summary>
+	/// What a kernel sums.
+	/// </summary>
+	enum class Mode
+	{
+		/// <summary>
+		/// Like `kernel::gravity`: sum m s / |s|^3.
+		/// </summary>
+		field,
+		/// <summary>
+		/// Like `kernel::mutual`: also subtract the reaction (gm s / |s|^3) from `ax`, `ay`.
+		/// </summary>
+		mutual,
+		/// <summary>
+		/// Like `kernel::potential`: sum m / |s| (into the real part).
+		/// </summary>
+		potential,
+	};
+
+	/// <summary>
+	/// A kernel: like `kernel::gravity` without `self` and `G` (adds to `count`),
+	/// with `gm` = G m (see `Mode`).
+	/// </summary>
+	typedef C(*Kernel)(Sources const& s, int begin, int end, C const& z, double r, double gm, double* ax, double* ay, int* deferred, int& count);
+
+	template <Mode M>
+	C scalar(Sources const& s, int begin, int end, C const& z, double r, double gm, double* ax, double* ay, int* deferred, int& count)
+	{
+		double sx{}, sy{};
+		for (int j = begin; j < end; j++)
+		{
+			double const dx = s.x[j] - z.real(), dy = s.y[j] - z.imag();
+			double const r2 = dx * dx + dy * dy, reach = s.r[j] + r;
+			if (!(r2 >= tiny) || r2 > huge || r2 < reach * reach)
+			{
+				deferred[count++] = j;
+				continue;
+			}
+			double const y = 1 / sqrt(r2);
+			if (M == Mode::potential)
+			{
+				sx += s.m[j] * y;
+				continue;
+			}
+			double const y3 = y * y * y, w = s.m[j] * y3;
+			sx += w * dx, sy += w * dy;
+			if (M == Mode::mutual) ax[j] -= gm * y3 * dx, ay[j] -= gm * y3 * dy;
+		}
+		return C(sx, sy);
+	}
+
+#ifdef KERNEL_X86
+	template <Mode M>
+	KERNEL_TARGET("avx2,fma")
+	C avx2(Sources const& s, int begin, int end, C const& z, double r, double gm, double* ax, double* ay, int* deferred, int& count)
+	{
+		__m256d const zx = _mm256_set1_pd(z.real()), zy = _mm256_set1_pd(z.imag()), rr = _mm256_set1_pd(r);
+		__m256d const lo = _mm256_set1_pd(tiny), hi = _mm256_set1_pd(huge);
+		__m256d const half = _mm256_set1_pd(.5), three_halves = _mm256_set1_pd(1.5);
+		__m256d const g = _mm256_set1_pd(gm);
+		__m256d sx = _mm256_setzero_pd(), sy = _mm256_setzero_pd();
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			__m256d const dx = _mm256_sub_pd(_mm256_loadu_pd(s.x + j), zx);
+			__m256d const dy = _mm256_sub_pd(_mm256_loadu_pd(s.y + j), zy);
+			__m256d const r2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+			__m256d const reach = _mm256_add_pd(_mm256_loadu_pd(s.r + j), rr);
+			// Lanes to defer (overlapping, or out of range).
+			__m256d const odd = _mm256_or_pd(
+				_mm256_or_pd(_mm256_cmp_pd(r2, lo, _CMP_NGE_UQ), _mm256_cmp_pd(r2, hi, _CMP_GT_OQ)),
+				_mm256_cmp_pd(r2, _mm256_mul_pd(reach, reach), _CMP_LT_OQ));
+			// 1/sqrt(r2): 12 bits in single precision, then two steps of Newton's method
+			// (each doubles the number of correct bits).
+			__m256d y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+			__m256d const h = _mm256_mul_pd(half, r2);
+			y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), three_halves));
+			y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), three_halves));
+			if (M == Mode::potential)
+				sx = _mm256_fmadd_pd(_mm256_loadu_pd(s.m + j), _mm256_andnot_pd(odd, y), sx);
+			else
+			{
+				__m256d const y3 = _mm256_andnot_pd(odd, _mm256_mul_pd(y, _mm256_mul_pd(y, y)));
+				__m256d const w = _mm256_mul_pd(_mm256_loadu_pd(s.m + j), y3);
+				sx = _mm256_fmadd_pd(w, dx, sx);
+				sy = _mm256_fmadd_pd(w, dy, sy);
+				if (M == Mode::mutual)
+				{
+					__m256d const v = _mm256_mul_pd(g, y3);
+					_mm256_storeu_pd(ax + j, _mm256_fnmadd_pd(v, dx, _mm256_loadu_pd(ax + j)));
+					_mm256_storeu_pd(ay + j, _mm256_fnmadd_pd(v, dy, _mm256_loadu_pd(ay + j)));
+				}
+			}
+			if (int const d = _mm256_movemask_pd(odd))
+				for (int k = 0; k < 4; k++)
+					if (d >> k & 1) deferred[count++] = j + k;
+		}
+		// Sum the lanes.
+		__m128d const hx = _mm_add_pd(_mm256_castpd256_pd128(sx), _mm256_extractf128_pd(sx, 1));
+		__m128d const hy = _mm_add_pd(_mm256_castpd256_pd128(sy), _mm256_extractf128_pd(sy, 1));
+		C a(_mm_cvtsd_f64(_mm_add_sd(hx, _mm_unpackhi_pd(hx, hx))), _mm_cvtsd_f64(_mm_add_sd(hy, _mm_unpackhi_pd(hy, hy))));
+		return a + scalar<M>(s, j, end, z, r, gm, ax, ay, deferred, count);
+	}
+
+	template <Mode M>
+	KERNEL_TARGET("avx512f")
+	C avx512(Sources const& s, int begin, int end, C const& z, double r, double gm, double* ax, double* ay, int* deferred, int& count)
+	{
+		__m512d const zx = _mm512_set1_pd(z.real()), zy = _mm512_set1_pd(z.imag()), rr = _mm512_set1_pd(r);
+		__m512d const lo = _mm512_set1_pd(tiny), hi = _mm512_set1_pd(huge);
+		__m512d const half = _mm512_set1_pd(.5), three_halves = _mm512_set1_pd(1.5);
+		__m512d const g = _mm512_set1_pd(gm);
+		__m512d sx = _mm512_setzero_pd(), sy = _mm512_setzero_pd();
+		for (int j = begin; j < end; j += 8)
+		{
+			// The last few sources are loaded under a mask.
+			__mmask8 const live = end - j >= 8 ? (__mmask8)0xff : (__mmask8)((1u << (end - j)) - 1);
+			__m512d const dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(live, s.x + j), zx);
+			__m512d const dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(live, s.y + j), zy);
+			__m512d const r2 = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+			__m512d const reach = _mm512_add_pd(_mm512_maskz_loadu_pd(live, s.r + j), rr);
+			__mmask8 const odd = live & (__mmask8)(
+				_mm512_cmp_pd_mask(r2, lo, _CMP_NGE_UQ) | _mm512_cmp_pd_mask(r2, hi, _CMP_GT_OQ)
+				| _mm512_cmp_pd_mask(r2, _mm512_mul_pd(reach, reach), _CMP_LT_OQ));
+			// 1/sqrt(r2): 14 bits, then two steps of Newton's method.
+			__m512d y = _mm512_rsqrt14_pd(r2);
+			__m512d const h = _mm512_mul_pd(half, r2);
+			y = _mm512_mul_pd(y, _mm512_fnmadd_pd(h, _mm512_mul_pd(y, y), three_halves));
+			y = _mm512_mul_pd(y, _mm512_fnmadd_pd(h, _mm512_mul_pd(y, y), three_halves));
+			__mmask8 const sum = live & (__mmask8)~odd;
+			if (M == Mode::potential)
+				sx = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(live, s.m + j), _mm512_maskz_mov_pd(sum, y), sx);
+			else
+			{
+				__m512d const y3 = _mm512_maskz_mul_pd(sum, y, _mm512_mul_pd(y, y));
+				__m512d const w = _mm512_mul_pd(_mm512_maskz_loadu_pd(live, s.m + j), y3);
+				sx = _mm512_fmadd_pd(w, dx, sx);
+				sy = _mm512_fmadd_pd(w, dy, sy);
+				if (M == Mode::mutual)
+				{
+					__m512d const v = _mm512_mul_pd(g, y3);
+					_mm512_mask_storeu_pd(ax + j, live, _mm512_fnmadd_pd(v, dx, _mm512_maskz_loadu_pd(live, ax + j)));
+					_mm512_mask_storeu_pd(ay + j, live, _mm512_fnmadd_pd(v, dy, _mm512_maskz_loadu_pd(live, ay + j)));
+				}
+			}
+			if (odd)
+				for (int k = 0; k < 8; k++)
+					if (odd >> k & 1) deferred[count++] = j + k;
+		}
+		return C(_mm512_reduce_add_pd(sx), _mm512_reduce_add_pd(sy));
+	}
+#endif
+
+	/// <summary>
+	/// Margin (relative) by which single-precision kernels widen the reach,
+	/// so that no pair that overlaps in double precision is summed.
+	/// </summary>
+	float constexpr margin = 1 + 1e-4f;
+
+	/// <summary>
+	/// A kernel in mixed precision: like `Kernel` in the `Mode::field`.
+	/// </summary>
+	typedef C(*KernelF)(SourcesF const& s, int begin, int end, C const& z, double r, int* deferred, int& count);
+
+	C scalar_f(SourcesF const& s, int begin, int end, C const& z, double r, int* deferred, int& count)
+	{
+		float const zx = (float)z.real(), zy = (float)z.imag(), rr = (float)r;
+		double sx{}, sy{};
+		for (int j = begin; j < end; j++)
+		{
+			float const dx = s.x[j] - zx, dy = s.y[j] - zy;
+			float const r2 = dx * dx + dy * dy, reach = (s.r[j] + rr) * margin;
+			if (!(r2 >= (float)tiny) || r2 > (float)huge || r2 < reach * reach)
+			{
+				deferred[count++] = j;
+				continue;
+			}
+			float const y = 1 / std::sqrt(r2), w = s.m[j] * y * y * y;
+			sx += w * dx, sy += w * dy;
+		}
+		return C(sx, sy);
+	}
+
+#ifdef KERNEL_X86
+	KERNEL_TARGET("avx2,fma")
+	C avx2_f(SourcesF const& s, int begin, int end, C const& z, double r, int* deferred, int& count)
+	{
+		__m256 const zx = _mm256_set1_ps((float)z.real()), zy = _mm256_set1_ps((float)z.imag());
+		__m256 const rr = _mm256_set1_ps((float)r), wide = _mm256_set1_ps(margin);
+		__m256 const lo = _mm256_set1_ps((float)tiny), hi = _mm256_set1_ps((float)huge);
+		__m256 const half = _mm256_set1_ps(.5f), three_halves = _mm256_set1_ps(1.5f);
+		__m256d sx = _mm256_setzero_pd(), sy = _mm256_setzero_pd();
+		int j = begin;
+		for (; j + 8 <= end; j += 8)
+		{
+			__m256 const dx = _mm256_sub_ps(_mm256_loadu_ps(s.x + j), zx);
+			__m256 const dy = _mm256_sub_ps(_mm256_loadu_ps(s.y + j), zy);
+			__m256 const r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+			__m256 const reach = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.r + j), rr), wide);
+			__m256 const odd = _mm256_or_ps(
+				_mm256_or_ps(_mm256_cmp_ps(r2, lo, _CMP_NGE_UQ), _mm256_cmp_ps(r2, hi, _CMP_GT_OQ)),
+				_mm256_cmp_ps(r2, _mm256_mul_ps(reach, reach), _CMP_LT_OQ));
+			// 1/sqrt(r2): 12 bits, then one step of Newton's method.
+			__m256 y = _mm256_rsqrt_ps(r2);
+			y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(y, y), three_halves));
+			__m256 const w = _mm256_andnot_ps(odd, _mm256_mul_ps(_mm256_loadu_ps(s.m + j), _mm256_mul_ps(y, _mm256_mul_ps(y, y))));
+			// Sum in double precision.
+			__m256 const tx = _mm256_mul_ps(w, dx), ty = _mm256_mul_ps(w, dy);
+			sx = _mm256_add_pd(sx, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(tx)), _mm256_cvtps_pd(_mm256_extractf128_ps(tx, 1))));
+			sy = _mm256_add_pd(sy, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(ty)), _mm256_cvtps_pd(_mm256_extractf128_ps(ty, 1))));
+			if (int const d = _mm256_movemask_ps(odd))
+				for (int k = 0; k < 8; k++)
+					if (d >> k & 1) deferred[count++] = j + k;
+		}
+		__m128d const hx = _mm_add_pd(_mm256_castpd256_pd128(sx), _mm256_extractf128_pd(sx, 1));
+		__m128d const hy = _mm_add_pd(_mm256_castpd256_pd128(sy), _mm256_extractf128_pd(sy, 1));
+		C a(_mm_cvtsd_f64(_mm_add_sd(hx, _mm_unpackhi_pd(hx, hx))), _mm_cvtsd_f64(_mm_add_sd(hy, _mm_unpackhi_pd(hy, hy))));
+		return a + scalar_f(s, j, end, z, r, deferred, count);
+	}
+
+	KERNEL_TARGET("avx512f")
+	C avx512_f(SourcesF const& s, int begin, int end, C const& z, double r, int* deferred, int& count)
+	{
+		__m512 const zx = _mm512_set1_ps((float)z.real()), zy = _mm512_set1_ps((float)z.imag());
+		__m512 const rr = _mm512_set1_ps((float)r), wide = _mm512_set1_ps(margin);
+		__m512 const lo = _mm512_set1_ps((float)tiny), hi = _mm512_set1_ps((float)huge);
+		__m512 const half = _mm512_set1_ps(.5f), three_halves = _mm512_set1_ps(1.5f);
+		__m512d sx = _mm512_setzero_pd(), sy = _mm512_setzero_pd();
+		for (int j = begin; j < end; j += 16)
+		{
+			__mmask16 const live = end - j >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (end - j)) - 1);
+			__m512 const dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(live, s.x + j), zx);
+			__m512 const dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(live, s.y + j), zy);
+			__m512 const r2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+			__m512 const reach = _mm512_mul_ps(_mm512_add_ps(_mm512_maskz_loadu_ps(live, s.r + j), rr), wide);
+			__mmask16 const odd = live & (__mmask16)(
+				_mm512_cmp_ps_mask(r2, lo, _CMP_NGE_UQ) | _mm512_cmp_ps_mask(r2, hi, _CMP_GT_OQ)
+				| _mm512_cmp_ps_mask(r2, _mm512_mul_ps(reach, reach), _CMP_LT_OQ));
+			// 1/sqrt(r2): 14 bits, then one step of Newton's method.
+			__m512 y = _mm512_rsqrt14_ps(r2);
+			y = _mm512_mul_ps(y, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(y, y), three_halves));
+			__mmask16 const sum = live & (__mmask16)~odd;
+			__m512 const w = _mm512_maskz_mul_ps(sum, _mm512_maskz_loadu_ps(live, s.m + j), _mm512_mul_ps(y, _mm512_mul_ps(y, y)));
+			// Sum in double precision (8 lanes at a time).
+			__m512 const tx = _mm512_mul_ps(w, dx), ty = _mm512_mul_ps(w, dy);
+			sx = _mm512_add_pd(sx, _mm512_add_pd(
+				_mm512_cvtps_pd(_mm512_castps512_ps256(tx)),
+				_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(tx), 1)))));
+			sy = _mm512_add_pd(sy, _mm512_add_pd(
+				_mm512_cvtps_pd(_mm512_castps512_ps256(ty)),
+				_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(ty), 1)))));
+			if (odd)
+				for (int k = 0; k < 16; k++)
+					if (odd >> k & 1) deferred[count++] = j + k;
+		}
+		return C(_mm512_reduce_add_pd(sx), _mm512_reduce_add_pd(sy));
+	}
+#endif
+
+	/// <summary>
+	/// A kernel of accelerations and jerks: like `Kernel` in the `Mode::field`, but
+	/// also with the velocities `u` of the sources and `v` of the particle (adds the jerk to `jerk`).
+	/// </summary>
+	typedef C(*KernelJ)(Sources const& s, double const* ux, double const* uy, int begin, int end, C const& z, C const& v, double r, C& jerk, int* deferred, int& count);
+
+	C scalar_j(Sources const& s, double const* ux, double const* uy, int begin, int end, C const& z, C const& v, double r, C& jerk, int* deferred, int& count)
+	{
+		double sx{}, sy{}, jx{}, jy{};
+		for (int j = begin; j < end; j++)
+		{
+			double const dx = s.x[j] - z.real(), dy = s.y[j] - z.imag();
+			double const r2 = dx * dx + dy * dy, reach = s.r[j] + r;
+			if (!(r2 >= tiny) || r2 > huge || r2 < reach * reach)
+			{
+				deferred[count++] = j;
+				continue;
+			}
+			double const du = ux[j] - v.real(), dv = uy[j] - v.imag();
+			double const y = 1 / sqrt(r2), y2 = y * y, w = s.m[j] * y2 * y;
+			double const c = 3 * (dx * du + dy * dv) * y2;
+			sx += w * dx, sy += w * dy;
+			jx += w * (du - c * dx), jy += w * (dv - c * dy);
+		}
+		jerk += C(jx, jy);
+		return C(sx, sy);
+	}
+
+#ifdef KERNEL_X86
+	KERNEL_TARGET("avx2,fma")
+	C avx2_j(Sources const& s, double const* ux, double const* uy, int begin, int end, C const& z, C const& v, double r, C& jerk, int* deferred, int& count)
+	{
+		__m256d const zx = _mm256_set1_pd(z.real()), zy = _mm256_set1_pd(z.imag()), rr = _mm256_set1_pd(r);
+		__m256d const vx = _mm256_set1_pd(v.real()), vy = _mm256_set1_pd(v.imag());
+		__m256d const lo = _mm256_set1_pd(tiny), hi = _mm256_set1_pd(huge);
+		__m256d const half = _mm256_set1_pd(.5), three_halves = _mm256_set1_pd(1.5), three = _mm256_set1_pd(3);
+		__m256d sx = _mm256_setzero_pd(), sy = _mm256_setzero_pd(), jx = _mm256_setzero_pd(), jy = _mm256_setzero_pd();
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			__m256d const dx = _mm256_sub_pd(_mm256_loadu_pd(s.x + j), zx);
+			__m256d const dy = _mm256_sub_pd(_mm256_loadu_pd(s.y + j), zy);
+			__m256d const r2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+			__m256d const reach = _mm256_add_pd(_mm256_loadu_pd(s.r + j), rr);
+			__m256d const odd = _mm256_or_pd(
+				_mm256_or_pd(_mm256_cmp_pd(r2, lo, _CMP_NGE_UQ), _mm256_cmp_pd(r2, hi, _CMP_GT_OQ)),
+				_mm256_cmp_pd(r2, _mm256_mul_pd(reach, reach), _CMP_LT_OQ));
+			// 1/sqrt(r2), as in `avx2`.
+			__m256d y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+			__m256d const h = _mm256_mul_pd(half, r2);
+			y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), three_halves));
+			y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), three_halves));
+			__m256d const y2 = _mm256_mul_pd(y, y);
+			__m256d const w = _mm256_andnot_pd(odd, _mm256_mul_pd(_mm256_loadu_pd(s.m + j), _mm256_mul_pd(y, y2)));
+			sx = _mm256_fmadd_pd(w, dx, sx);
+			sy = _mm256_fmadd_pd(w, dy, sy);
+			// Relative velocity, and 3 (s . u) / |s|^2 (masked like `w`: at a coincident
+			// source it's 0 times infinity, which would otherwise make the jerk not a number).
+			__m256d const du = _mm256_sub_pd(_mm256_loadu_pd(ux + j), vx);
+			__m256d const dv = _mm256_sub_pd(_mm256_loadu_pd(uy + j), vy);
+			__m256d const c = _mm256_andnot_pd(odd,
+				_mm256_mul_pd(three, _mm256_mul_pd(_mm256_fmadd_pd(dx, du, _mm256_mul_pd(dy, dv)), y2)));
+			jx = _mm256_fmadd_pd(w, _mm256_fnmadd_pd(c, dx, du), jx);
+			jy = _mm256_fmadd_pd(w, _mm256_fnmadd_pd(c, dy, dv), jy);
+			if (int const d = _mm256_movemask_pd(odd))
+				for (int k = 0; k < 4; k++)
+					if (d >> k & 1) deferred[count++] = j + k;
+		}
+		// Sum the lanes.
+		__m128d const hx = _mm_add_pd(_mm256_castpd256_pd128(sx), _mm256_extractf128_pd(sx, 1));
+		__m128d const hy = _mm_add_pd(_mm256_castpd256_pd128(sy), _mm256_extractf128_pd(sy, 1));
+		__m128d const gx = _mm_add_pd(_mm256_castpd256_pd128(jx), _mm256_extractf128_pd(jx, 1));
+		__m128d const gy = _mm_add_pd(_mm256_castpd256_pd128(jy), _mm256_extractf128_pd(jy, 1));
+		C const a(_mm_cvtsd_f64(_mm_add_sd(hx, _mm_unpackhi_pd(hx, hx))), _mm_cvtsd_f64(_mm_add_sd(hy, _mm_unpackhi_pd(hy, hy))));
+		jerk += C(_mm_cvtsd_f64(_mm_add_sd(gx, _mm_unpackhi_pd(gx, gx))), _mm_cvtsd_f64(_mm_add_sd(gy, _mm_unpackhi_pd(gy, gy))));
+		return a + scalar_j(s, ux, uy, j, end, z, v, r, jerk, deferred, count);
+	}
+#endif
+
+	Isa detect()
+	{
+#ifdef KERNEL_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+		int r[4];
+		__cpuid(r, 0);
+		if (r[0] < 7) return Isa::scalar;
+		__cpuid(r, 1);
+		bool const fma = r[2] >> 12 & 1, osxsave = r[2] >> 27 & 1;
+		if (!fma || !osxsave) return Isa::scalar;
+		// Whether the operating system saves the registers (YMM; and ZMM, opmasks).
+		unsigned long long const xcr = _xgetbv(0);
+		__cpuidex(r, 7, 0);
+		if ((r[1] >> 16 & 1) && (xcr & 0xe6) == 0xe6) return Isa::avx512;
+		if ((r[1] >> 5 & 1) && (xcr & 0x6) == 0x6) return Isa::avx2;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return Isa::avx512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::avx2;
+#endif
+#endif
+		return Isa::scalar;
+	}
+
+	template <Mode M>
+	Kernel chosen()
+	{
+		switch (isa())
+		{
+#ifdef KERNEL_X86
+		case Isa::avx512: return avx512<M>;
+		case Isa::avx2: return avx2<M>;
+#endif
+		default: return scalar<M>;
+		}
+	}
+
+	KernelJ chosen_j()
+	{
+		switch (isa())
+		{
+#ifdef KERNEL_X86
+		// (AVX-512 processors have AVX2 too.)
+		case Isa::avx512:
+		case Isa::avx2: return avx2_j;
+#endif
+		default: return scalar_j;
+		}
+	}
+
+	KernelF chosen_f()
+	{
+		switch (isa())
+		{
+#ifdef KERNEL_X86
+		case Isa::avx512: return avx512_f;
+		case Isa::avx2: return avx2_f;
+#endif
+		default: return scalar_f;
+		}
+	}
+}
+
+Isa kernel::isa()
+{
+	static Isa const best = detect();
+	return best;
+}
+
+C kernel::gravity(Sources const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count)
+{
+	static Kernel const k = chosen<Mode::field>();
+	count = 0;
+	C a;
+	// Leave out `self` by splitting the range around it.
+	if (begin <= self && self < end)
+		a = k(s, begin, self, z, r, 0, nullptr, nullptr, deferred, count) + k(s, self + 1, end, z, r, 0, nullptr, nullptr, deferred, count);
+	else
+		a = k(s, begin, end, z, r, 0, nullptr, nullptr, deferred, count);
+	return G * a;
+}
+
+C kernel::mutual(Sources const& s, int begin, int end, C const& z, double m, double r, double G, double* ax, double* ay, int* deferred, int& count)
+{
+	static Kernel const k = chosen<Mode::mutual>();
+	count = 0;
+	return G * k(s, begin, end, z, r, G * m, ax, ay, deferred, count);
+}
+
+double kernel::potential(Sources const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count)
+{
+	static Kernel const k = chosen<Mode::potential>();
+	count = 0;
+	C u;
+	if (begin <= self && self < end)
+		u = k(s, begin, self, z, r, 0, nullptr, nullptr, deferred, count) + k(s, self + 1, end, z, r, 0, nullptr, nullptr, deferred, count);
+	else
+		u = k(s, begin, end, z, r, 0, nullptr, nullptr, deferred, count);
+	return -G * u.real();
+}
+
+C kernel::gravity(SourcesF const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count)
+{
+	static KernelF const k = chosen_f();
+	count = 0;
+	C a;
+	if (begin <= self && self < end)
+		a = k(s, begin, self, z, r, deferred, count) + k(s, self + 1, end, z, r, deferred, count);
+	else
+		a = k(s, begin, end, z, r, deferred, count);
+	return G * a;
+}
+
+C kernel::gravity(Sources const& s, double const* vx, double const* vy, int begin, int end, int self, C const& z, C const& v, double r, double G, C& jerk, int* deferred, int& count)
+{
+	static KernelJ const k = chosen_j();
+	count = 0;
+	C a, j;
+	if (begin <= self && self < end)
+		a = k(s, vx, vy, begin, self, z, v, r, j, deferred, count) + k(s, vx, vy, self + 1, end, z, v, r, j, deferred, count);
+	else
+		a = k(s, vx, vy, begin, end, z, v, r, j, deferred, count);
+	jerk = G * j;
+	return G * a;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "Include.h"
+
+/// <summary>
+/// Vectorized (SIMD) kernels for the inverse-square law.
+///
+/// The kernels are compiled for several instruction sets, and the best one
+/// that the processor supports is chosen at run time (the first time
+/// a kernel is called).
+/// </summary>
+namespace kernel
+{
+	/// <summary>
+	/// Instruction sets that the kernels are compiled for.
+	/// </summary>
+	enum class Isa
+	{
+		/// <summary>
+		/// Plain C++, one pair at a time.
+		/// </summary>
+		scalar,
+		/// <summary>
+		/// AVX2 with FMA: 4 sources at a time.
+		/// </summary>
+		avx2,
+		/// <summary>
+		/// AVX-512 (foundation): 8 sources at a time.
+		/// </summary>
+		avx512,
+	};
+
+	/// <summary>
+	/// Recall the instruction set chosen for this processor.
+	/// </summary>
+	Isa isa();
+
+	/// <summary>
+	/// Sources for `gravity`: columns of positions, masses, and radii.
+	/// </summary>
+	struct Sources
+	{
+		double const* x;
+		double const* y;
+		double const* m;
+		double const* r;
+	};
+
+	/// <summary>
+	/// Sources in single precision (see `gravity` for `SourcesF`). The positions
+	/// are relative to an origin of the caller's choice (e.g., the barycenter),
+	/// so that they keep as many significant digits as they can.
+	/// </summary>
+	struct SourcesF
+	{
+		float const* x;
+		float const* y;
+		float const* m;
+		float const* r;
+	};
+
+	/// <summary>
+	/// Compute the acceleration felt at `z` by a particle of radius `r`
+	/// due to the sources at the indices [begin, end), except for `self`:
+	///
+	///     G sum m(j) s(j) / |s(j)|^3, where s(j) = z(j) - z.
+	///
+	/// Sources that overlap the particle (|s(j)| &lt; r + r(j)) are not summed;
+	/// the law doesn't apply to them. Nor are those so close or so far
+	/// that the reciprocal square root can't be estimated in single precision
+	/// (the estimate is then refined in double precision). Their indices
+	/// are written to `deferred` instead, for the caller to handle
+	/// one at a time (e.g., with the lune integral).
+	///
+	/// The relative error of each term is about 1e-13 (AVX2) or less.
+	/// Overlapping is decided exactly like `grid::overlap`.
+	/// </summary>
+	/// <param name="s">Sources</param>
+	/// <param name="begin">First index</param>
+	/// <param name="end">One past the last index</param>
+	/// <param name="self">Index to skip (or -1)</param>
+	/// <param name="z">Position of the particle (L)</param>
+	/// <param name="r">Radius of the particle (L)</param>
+	/// <param name="G">Gravitational constant (LLL/T/T/M)</param>
+	/// <param name="deferred">Room for up to (end - begin) indices</param>
+	/// <param name="count">Number of indices written to `deferred`</param>
+	/// <returns>Acceleration (L/T/T)</returns>
+	C gravity(Sources const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count);
+
+	/// <summary>
+	/// Like `gravity`, but for the pairs of the particle (of mass `m`) with
+	/// the sources at once (Newton's third law): also add the reaction, the acceleration
+	/// of each source due to the particle, to `ax` and `ay` (indexed like the sources).
+	/// Deferred sources get no reaction. There's no `self`; leave it out of the range.
+	/// </summary>
+	/// <param name="m">Mass of the particle (M)</param>
+	/// <param name="ax">Accelerations of the sources, real parts (L/T/T)</param>
+	/// <param name="ay">Accelerations of the sources, imaginary parts (L/T/T)</param>
+	C mutual(Sources const& s, int begin, int end, C const& z, double m, double r, double G, double* ax, double* ay, int* deferred, int& count);
+
+	/// <summary>
+	/// Like `gravity`, but with the sources in single precision (mixed precision):
+	/// twice as many sources at a time, and half the memory traffic. Each
+	/// term is evaluated in single precision (relative error about 1e-6, plus
+	/// the rounding of the positions) and summed in double precision.
+	///
+	/// Sources that could overlap the particle, as far as single precision
+	/// can tell, are deferred (so some that don't overlap are deferred too;
+	/// decide them again in double precision).
+	/// </summary>
+	/// <param name="z">Position of the particle (L), relative to the origin of the sources</param>
+	C gravity(SourcesF const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count);
+
+	/// <summary>
+	/// Like `gravity`, but compute the potential (per unit mass) at `z` instead:
+	///
+	///     -G sum m(j) / |s(j)|.
+	///
+	/// The same sources are deferred.
+	/// </summary>
+	/// <returns>Potential (LL/T/T)</returns>
+	double potential(Sources const& s, int begin, int end, int self, C const& z, double r, double G, int* deferred, int& count);
+
+	/// <summary>
+	/// Like `gravity`, but for a particle moving at `v` among sources moving at
+	/// (`vx`, `vy`): also compute the jerk, the time derivative of the acceleration,
+	/// in the same loop:
+	///
+	///     G sum m(j) (u(j) / |s(j)|^3 - 3 (s(j) . u(j)) s(j) / |s(j)|^5), where u(j) = v(j) - v.
+	///
+	/// The same sources are deferred (and left out of both sums).
+	/// </summary>
+	/// <param name="vx">Velocities of the sources, real parts (L/T)</param>
+	/// <param name="vy">Velocities of the sources, imaginary parts (L/T)</param>
+	/// <param name="v">Velocity of the particle (L/T)</param>
+	/// <param name="jerk">Jerk (L/T/T/T)</param>
+	C gravity(Sources const& s, double const* vx, double const* vy, int begin, int end, int self, C const& z, C const& v, double r, double G, C& jerk, int* deferred, int& count);
+}
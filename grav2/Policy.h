@@ -0,0 +1,895 @@
+#pragma once
+#include "Dyn.h"
+#include "Beasons.h"
+#include "Kernel.h"
+#include <algorithm>
+#include <utility>
+
+/// <summary>
+/// Behavior of the simulation (force, judgement of errors, and integration)
+/// chosen at compile time.
+/// 
+/// `Dyn` calls its drivers (`Dyn::Driver`) through `std::function`, which can't be
+/// inlined into the loops over particles. `Static` takes the same behavior
+/// as types (policies) instead. The run-time pluggable drivers are themselves
+/// available as policies, which is how `Dyn` is implemented.
+/// </summary>
+namespace dyn
+{
+	/// <summary>
+	/// Policies for `Static` (and for `Dyn`).
+	/// </summary>
+	namespace policy
+	{
+		/// <summary>
+		/// Force policy: call `Dyn::Driver::pair_force` (zero if there is none).
+		/// </summary>
+		struct DriverForce
+		{
+			Dyn::Driver const& drv;
+
+			C operator()(Dyn::Entry const& l, Dyn::Entry const& r) const
+			{
+				return drv.pair_force ? drv.pair_force(l, r) : C();
+			}
+		};
+
+		/// <summary>
+		/// Decide whether a force policy computes any force at all (if not, the
+		/// accelerations are zero). Force policies are, unless overloaded here.
+		/// </summary>
+		template <class Force>
+		bool active(Force const&) { return true; }
+
+		inline bool active(DriverForce const& f) { return (bool)f.drv.pair_force; }
+
+		/// <summary>
+		/// Judge policy: call `Dyn::Driver::judge_z` and `judge_v` (neutral if there are none).
+		/// </summary>
+		struct DriverJudge
+		{
+			Dyn::Driver const& drv;
+
+			int z(C const& strong, C const& weak) const { return drv.judge_z ? drv.judge_z(strong, weak) : 0; }
+			int v(C const& strong, C const& weak) const { return drv.judge_v ? drv.judge_v(strong, weak) : 0; }
+		};
+
+		/// <summary>
+		/// Judge policy: always neutral.
+		/// </summary>
+		struct Neutral
+		{
+			int z(C const&, C const&) const { return 0; }
+			int v(C const&, C const&) const { return 0; }
+		};
+
+		/// <summary>
+		/// Integrator policy: an explicit Runge-Kutta method with the tableau `T` (see Butcher.h).
+		/// </summary>
+		template <class T>
+		struct Explicit
+		{
+			typedef T Tableau;
+
+			template <class F>
+			butcher::Results operator()(double h, F const& f, C const& y0, C const& y1, C const& y2) const
+			{
+				return butcher::integrate<T>(h, f, y0, y1, y2);
+			}
+		};
+
+		/// <summary>
+		/// Integrator policy: Beason's method adapted to Bogacki-Shampine (see Beasons.h).
+		/// </summary>
+		struct BogackiShampine : Explicit<butcher::BogackiShampine32> {};
+
+		/// <summary>
+		/// Integrator policy: Dormand-Prince 5(4).
+		/// </summary>
+		struct DormandPrince : Explicit<butcher::DormandPrince54> {};
+
+		/// <summary>
+		/// Integrator policy: Verner 6(5).
+		/// </summary>
+		struct Verner : Explicit<butcher::Verner65> {};
+
+		/// <summary>
+		/// Recall the tableau of an integrator policy (`type`), for the schemes
+		/// that take all particles through the stages together; Bogacki-Shampine
+		/// for the policies that don't say.
+		/// </summary>
+		template <class Integrator, class = void>
+		struct TableauOf { typedef butcher::BogackiShampine32 type; };
+
+		template <class> struct Void { typedef void type; };
+
+		template <class Integrator>
+		struct TableauOf<Integrator, typename Void<typename Integrator::Tableau>::type> { typedef typename Integrator::Tableau type; };
+	}
+
+	/// <summary>
+	/// Simulation whose behavior is fixed at compile time.
+	/// 
+	/// The policies are default-constructed, and can be accessed
+	/// as `force`, `judge`, and `integrate`. The drivers in `drv` are not used
+	/// by `precompute`, `step`, and `accelerations` (except `Driver::gravity` and `Driver::symmetric`,
+	/// which describe `Force`), but they can still be filled in for code that takes a `Dyn`.
+	/// </summary>
+	/// <typeparam name="Force">Callable as `C(Dyn::Entry const&amp; l, Dyn::Entry const&amp; r)`</typeparam>
+	/// <typeparam name="Judge">Has the members `int z(C const&amp;, C const&amp;)` and `int v(C const&amp;, C const&amp;)`</typeparam>
+	/// <typeparam name="Integrator">Callable as `beasons::beason_bogacki_shampine` is (e.g., `policy::Explicit`)</typeparam>
+	template <class Force, class Judge = policy::Neutral, class Integrator = policy::BogackiShampine>
+	class Static : public Dyn
+	{
+	public:
+		Force force;
+		Judge judge;
+		Integrator integrate;
+
+		using Dyn::Dyn;
+
+		/// <summary>
+		/// See `Dyn::precompute`.
+		/// </summary>
+		void precompute() { initialize(force); }
+
+		/// <summary>
+		/// See `Dyn::accelerations`.
+		/// </summary>
+		void accelerations() { gather(force); }
+
+		/// <summary>
+		/// See `Dyn::step`.
+		/// </summary>
+		void step() { advance(force, judge, integrate); }
+	};
+
+	// :: Definitions of the member templates of `Dyn`. ::
+
+	template <class Force>
+	void Dyn::initialize(Force const& force)
+	{
+		for (int i = n() - 1; i >= 0; i--)
+		{
+			m_mass += tab.m[i];
+			m_area += tab.r[i] * tab.r[i] * PI64;
+		}
+		gather(force);
+	}
+
+	template <class Force>
+	void Dyn::gather(Force const& force)
+	{
+		Lap lap(stats.gather, &stats.prepare);
+		stats.evaluations += n();
+		prepare(policy::active(force));
+		if (!quad.built() && !multipole.built())
+		{
+			pairwise(force);
+			return;
+		}
+		// (Each worker writes only the accelerations of its own particles,
+		// which no one else reads.)
+		parallel(n(), [&](int begin, int end, int)
+			{
+				for (int i = end - 1; i >= begin; i--) tab.set_a(i, accelerate(i, tab.z(i), force));
+			});
+	}
+
+	template <class Force>
+	void Dyn::pairwise(Force const& force)
+	{
+		int const N = n(), W = concurrency();
+		if (!policy::active(force))
+		{
+			std::fill(tab.ax.begin(), tab.ax.end(), 0.), std::fill(tab.ay.begin(), tab.ay.end(), 0.);
+			return;
+		}
+		sums.resize(2 * W);
+		for (auto& c : sums) c.assign(N, 0);
+		kernel::Sources const s{ tab.x.data(), tab.y.data(), tab.m.data(), tab.r.data() };
+		// Row i pairs the particle i with those after it. Rows i and N - 1 - i are
+		// done together, so that every index given to `parallel` is worth about N pairs.
+		parallel((N + 1) / 2, [&](int begin, int end, int worker)
+			{
+				double* ax = sums[2 * worker].data();
+				double* ay = sums[2 * worker + 1].data();
+				int constexpr B = 512;
+				int deferred[B], count;
+				// Force on `e` (at index i) by particle j; the reaction goes to j.
+				auto pair = [&](Entry const& e, int j)
+					{
+						C const f = force(e, tab.source(j));
+						C const g = drv.symmetric ? -f : force(tab[j], e);
+						ax[j] += g.real() / tab.m[j], ay[j] += g.imag() / tab.m[j];
+						return f;
+					};
+				auto row = [&](int i)
+					{
+						Entry const e = tab[i];
+						C a, f;
+						for (int b = i + 1; b < N; b += B)
+						{
+							int const c = std::min(N, b + B);
+							if (!drv.gravity)
+							{
+								for (int j = b; j < c; j++) f += pair(e, j);
+								continue;
+							}
+							a += kernel::mutual(s, b, c, e.z, e.m, e.r, drv.gravity, ax, ay, deferred, count);
+							// Deferred but not overlapping: the inverse-square law, one at a time.
+							// (The overlapping pairs are done below.)
+							for (int k = 0; k < count; k++)
+							{
+								int const j = deferred[k];
+								double const dx = tab.x[j] - e.z.real(), dy = tab.y[j] - e.z.imag();
+								if (grid::overlap(dx, dy, e.r + tab.r[j])) continue;
+								double const d2 = dx * dx + dy * dy;
+								C const g = drv.gravity / (d2 * sqrt(d2)) * C(dx, dy);
+								if (!finite(g)) continue;
+								a += tab.m[j] * g;
+								ax[j] -= e.m * g.real(), ay[j] -= e.m * g.imag();
+							}
+						}
+						a += f / e.m;
+						ax[i] += a.real(), ay[i] += a.imag();
+					};
+				for (int k = begin; k < end; k++)
+				{
+					row(k);
+					if (N - 1 - k != k) row(N - 1 - k);
+				}
+			});
+		if (drv.gravity)
+		{
+			// The overlapping pairs, found on the lists of contacts.
+			auto const& pairs = contacts.all();
+			parallel((int)pairs.size(), [&](int begin, int end, int worker)
+				{
+					double* ax = sums[2 * worker].data();
+					double* ay = sums[2 * worker + 1].data();
+					for (int k = begin; k < end; k++)
+					{
+						int const i = pairs[k].first, j = pairs[k].second;
+						if (!grid::overlap(tab.x[j] - tab.x[i], tab.y[j] - tab.y[i], tab.r[i] + tab.r[j])) continue;
+						Entry const e = tab[i];
+						C const f = force(e, tab.source(j));
+						C const g = drv.symmetric ? -f : force(tab[j], tab.source(i));
+						ax[i] += f.real() / e.m, ay[i] += f.imag() / e.m;
+						ax[j] += g.real() / tab.m[j], ay[j] += g.imag() / tab.m[j];
+					}
+				});
+		}
+		// Add up the accumulators of all workers.
+		parallel(N, [&](int begin, int end, int)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					C a;
+					for (int w = 0; w < W; w++) a += C(sums[2 * w][i], sums[2 * w + 1][i]);
+					tab.set_a(i, a);
+				}
+			});
+	}
+
+	template <class Force, class Judge, class Integrator>
+	void Dyn::advance(Force const& force, Judge const& judge, Integrator const& integrate)
+	{
+		Lap lap(stats.integrate, &stats.prepare);
+		if (par.merge > 0) merge();
+		before = tab, since = stats.time;
+		// (The step is `par.dt` long, whichever way it's taken; `par.dt` changes at the end.)
+		stats.steps++, stats.time += par.dt;
+		if (par.scheme == Scheme::hermite)
+		{
+			hermite(force);
+			return;
+		}
+		if (par.blocks)
+		{
+			subcycle(force, judge, integrate);
+			return;
+		}
+		if (par.scheme == Scheme::coupled)
+		{
+			couple(force, judge, integrate);
+			return;
+		}
+		if (par.scheme == Scheme::leapfrog || par.scheme == Scheme::forest_ruth)
+		{
+			leap(force);
+			return;
+		}
+
+		// Votes of each worker (padded so that workers don't share cache lines):
+		// - Are there cases that are too inaccurate (`go_finer`)?
+		// - Are there cases that suggest integration step size may be safely increased (`go_coarser`)?
+		// Also, the largest error norm (with `Param::atol`), and counts of the work done (see `Stats`).
+		struct Votes { bool go_finer{}, go_coarser{}; double error{}; long long evaluations{}, retries{}; char padding[32]; };
+
+		// There's some freedom/direction in handling the case where go_finer && go_coarser.
+		// Then either case is assuming priority.
+		// See the rest of this function body for how that's handled.
+
+		bool const controlled = par.atol > 0;
+		// `tab` keeps the start of the step (which the others are seen at), and `copy` gets the end.
+		copy = tab;
+		prepare(policy::active(force));
+		for (bool rejected = false;; rejected = true)
+		{
+			std::vector<Votes> votes(concurrency());
+			parallel(n(), [&](int begin, int end, int worker)
+				{
+					// Votes of this worker.
+					bool& go_finer = votes[worker].go_finer;
+					bool& go_coarser = votes[worker].go_coarser;
+					long long& evaluations = votes[worker].evaluations;
+
+					for (int i = end - 1; i >= begin; i--)
+					{
+						Entry const start = tab[i];
+						auto accel = [&](C const& z, C const&)
+							{
+								evaluations++;
+								return accelerate(i, z, force);
+							};
+						// Latest results from the integrator.
+						beasons::BeasonsResults aa;
+
+						if (controlled)
+						{
+							// The whole step is judged at once (below).
+							aa = integrate(par.dt, accel, start.z, start.v, start.a);
+							votes[worker].error = std::max(votes[worker].error, error(start, aa));
+						}
+						else
+						{
+							// ::: Beason's method of integration with step size adjustment. :::
+
+							// Cover the step in this many sub-steps, each starting from the
+							// acceleration at the end of the last (first same as last).
+							// Doubled when a judge objects, up to 4 times (`motivation`).
+							int parts = 1;
+							for (int motivation = 4;;)
+							{
+								double const dt = par.dt / parts;
+								C z = start.z, v = start.v, a = start.a;
+								bool objection = false;
+								for (int k = 0; k < parts; k++)
+								{
+									aa = integrate(dt, accel, z, v, a);
+									// Negative: inhibition, try finer time step.
+									// Zero: neutral, do nothing in particular.
+									// Positive: ambition, try coarser time step.
+									int const jz = judge.z(aa.y0_strong, aa.y0_weak), jv = judge.v(aa.y1_strong, aa.y1_weak);
+									objection |= jz < 0 || jv < 0;
+									go_coarser |= jz > 0 || jv > 0;
+									z = aa.y0_strong, v = aa.y1_strong, a = aa.y2;
+								}
+								if (!objection) break;
+								go_finer = true;
+								// Too little motivation (or time step) causes the loop to just give up.
+								if (!--motivation || dt / 2 < par.low_dt) break;
+								parts *= 2, votes[worker].retries++;
+							}
+						}
+
+						copy.set_z(i, aa.y0_strong);
+						copy.set_v(i, aa.y1_strong);
+						copy.set_a(i, aa.y2);
+					}
+				});
+
+			// Gather the votes.
+			bool go_finer{}, go_coarser{};
+			double err{};
+			for (auto const& v : votes)
+			{
+				go_finer |= v.go_finer, go_coarser |= v.go_coarser, err = std::max(err, v.error);
+				stats.evaluations += v.evaluations, stats.retries += v.retries;
+			}
+
+			if (!controlled)
+			{
+				// Apply *global* time step adjustment.
+				if (go_finer) par.dt = std::max(par.low_dt, par.dt / 2);
+				else if (go_coarser) par.dt = std::min(par.high_dt, par.dt * 2);
+				break;
+			}
+			double const dt = control(err, policy::TableauOf<Integrator>::type::order, rejected);
+			if (err <= 1 || par.dt <= par.low_dt)
+			{
+				par.dt = dt;
+				break;
+			}
+			// Rejected: take the step again, shorter (from the same accelerations at its start).
+			stats.time += dt - par.dt, stats.retries += n();
+			par.dt = dt;
+		}
+
+		std::swap(tab, copy);
+	}
+
+	template <class Force, class Judge, class Integrator>
+	void Dyn::couple(Force const& force, Judge const& judge, Integrator const&)
+	{
+		typedef typename policy::TableauOf<Integrator>::type T;
+		int const N = n();
+		// The stages start from the accelerations of the last step (first same as last),
+		// unless there are none.
+		bool given = true;
+		for (int i = 0; i < N && given; i++) given = finite(tab.a(i));
+		if (!given) gather(force), before = tab;
+
+		copy = tab;
+		std::vector<butcher::Stages<T>> stages(N);
+		bool const controlled = par.atol > 0;
+		for (bool rejected = false;; rejected = true)
+		{
+			double const h = par.dt;
+			parallel(N, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++) butcher::start(stages[i], copy.z(i), copy.v(i), copy.a(i));
+				});
+			auto each = [&](auto k)
+				{
+					int constexpr K = decltype(k)::value;
+					// Move everyone to the stage, and then evaluate everyone there.
+					parallel(N, [&](int begin, int end, int)
+						{
+							for (int i = begin; i < end; i++)
+							{
+								butcher::stage<T, K>(stages[i], h);
+								tab.set_z(i, stages[i].y0s[K]), tab.set_v(i, stages[i].y1s[K]);
+							}
+						});
+					gather(force);
+					parallel(N, [&](int begin, int end, int)
+						{
+							for (int i = begin; i < end; i++) stages[i].y2s[K] = tab.a(i);
+						});
+				};
+			butcher::each_stage<T>(each);
+
+			// Votes of each worker (see `advance`). With the judges, the step is not taken
+			// again; they only change the time step of the next one.
+			struct Votes { bool go_finer{}, go_coarser{}; double error{}; char padding[48]; };
+			std::vector<Votes> votes(concurrency());
+			parallel(N, [&](int begin, int end, int worker)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						butcher::Results const aa = butcher::finish(stages[i], h);
+						if (controlled)
+						{
+							votes[worker].error = std::max(votes[worker].error, error(copy[i], aa));
+							continue;
+						}
+						int const jz = judge.z(aa.y0_strong, aa.y0_weak), jv = judge.v(aa.y1_strong, aa.y1_weak);
+						if (jz < 0 || jv < 0) votes[worker].go_finer = true;
+						else if (jz > 0 || jv > 0) votes[worker].go_coarser = true;
+					}
+				});
+
+			bool go_finer{}, go_coarser{};
+			double err{};
+			for (auto const& v : votes) go_finer |= v.go_finer, go_coarser |= v.go_coarser, err = std::max(err, v.error);
+			if (controlled)
+			{
+				double const dt = control(err, T::order, rejected);
+				if (err > 1 && par.dt > par.low_dt)
+				{
+					// Rejected: go through the stages again with a shorter step
+					// (from the same accelerations at the start).
+					stats.time += dt - par.dt, stats.retries += N;
+					par.dt = dt;
+					continue;
+				}
+				par.dt = dt;
+			}
+			else if (go_finer) par.dt = std::max(par.low_dt, par.dt / 2);
+			else if (go_coarser) par.dt = std::min(par.high_dt, par.dt * 2);
+
+			parallel(N, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						butcher::Results const aa = butcher::finish(stages[i], h);
+						copy.set_z(i, aa.y0_strong);
+						copy.set_v(i, aa.y1_strong);
+						copy.set_a(i, aa.y2);
+					}
+				});
+			break;
+		}
+
+		std::swap(tab, copy);
+		// (Without the last stage at the end, the accelerations there are one more evaluation.)
+		if (!T::fsal) gather(force);
+	}
+
+	template <class Force>
+	void Dyn::leap(Force const& force)
+	{
+		int const N = n();
+		// The kicks start from the accelerations of the last step, unless there are none.
+		bool given = true;
+		for (int i = 0; i < N && given; i++) given = finite(tab.a(i));
+		if (!given) gather(force), before = tab;
+
+		// Kick (half), drift, evaluate, kick (half).
+		auto kdk = [&](double h)
+			{
+				parallel(N, [&](int begin, int end, int)
+					{
+						for (int i = begin; i < end; i++)
+						{
+							C const v = tab.v(i) + h / 2 * tab.a(i);
+							tab.set_v(i, v), tab.set_z(i, tab.z(i) + h * v);
+						}
+					});
+				gather(force);
+				parallel(N, [&](int begin, int end, int)
+					{
+						for (int i = begin; i < end; i++) tab.set_v(i, tab.v(i) + h / 2 * tab.a(i));
+					});
+			};
+		if (par.scheme == Scheme::forest_ruth)
+		{
+			double const w = 1 / (2 - std::cbrt(2.));
+			kdk(w * par.dt), kdk((1 - 2 * w) * par.dt), kdk(w * par.dt);
+		}
+		else
+			kdk(par.dt);
+	}
+
+	template <class Force>
+	void Dyn::hermite(Force const& force)
+	{
+		int const N = n();
+		// Number of levels below the block, as in `subcycle`.
+		int K = 0;
+		while (K < 30 && par.dt / (1 << (K + 1)) >= par.low_dt) K++;
+		double const tick = par.dt / (1 << K);
+		// The level whose step is at most `dt` (the finest if `dt` is too short,
+		// and the block if `dt` isn't a number: nothing changes).
+		auto level = [&](double dt)
+			{
+				int k = 0;
+				while (k < K && par.dt / (1 << k) > dt) k++;
+				return k;
+			};
+
+		// Start from the accelerations and jerks at the current state, unless they are known
+		// (from the last step), with steps as short as the acceleration changes (eta |a| / |a1|).
+		bool given = (int)jerks.size() == N && (int)levels.size() == N;
+		for (int i = 0; i < N && given; i++) given = finite(tab.a(i));
+		if (!given)
+		{
+			jerks.resize(N), levels.resize(N);
+			prepare(policy::active(force), false);
+			parallel(N, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						C a;
+						differentiate(i, a, jerks[i], force);
+						tab.set_a(i, a);
+						levels[i] = level(par.eta * std::abs(a) / std::abs(jerks[i]));
+					}
+				});
+			stats.evaluations += N;
+			before = tab;
+		}
+		for (auto& k : levels) k = std::min(k, K);
+
+		// Votes of each worker about the whole block (see `subcycle`).
+		struct Votes { bool go_coarser{}, stay{}; long long evaluations{}; char padding[48]; };
+		std::vector<Votes> votes(concurrency());
+
+		// `copy` holds the state of each particle at its own time, `ticks[i]` ticks
+		// into the block. `tab` holds everyone predicted to the current tick.
+		copy = tab;
+		std::vector<int> ticks(N), due;
+		for (;;)
+		{
+			// The particles whose steps end first (none once all are at the end of the block).
+			int T = (1 << K) + 1;
+			for (int i = 0; i < N; i++) T = std::min(T, ticks[i] + (1 << (K - levels[i])));
+			if (T > 1 << K) break;
+			due.clear();
+			for (int i = 0; i < N; i++) if (ticks[i] + (1 << (K - levels[i])) == T) due.push_back(i);
+
+			// Predict everyone to that time (to third order).
+			parallel(N, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						double const d = (T - ticks[i]) * tick;
+						C const a = copy.a(i), j = jerks[i];
+						tab.set_z(i, copy.z(i) + d * (copy.v(i) + d * (a / 2. + d * j / 6.)));
+						tab.set_v(i, copy.v(i) + d * (a + d * j / 2.));
+					}
+				});
+			prepare(policy::active(force), false);
+
+			// Correct the particles that are due, and choose their next steps.
+			parallel((int)due.size(), [&](int begin, int end, int worker)
+				{
+					for (int k = begin; k < end; k++)
+					{
+						int const i = due[k];
+						int const span = 1 << (K - levels[i]);
+						double const h = span * tick;
+						C a1, j1;
+						differentiate(i, a1, j1, force);
+						votes[worker].evaluations++;
+						C const z0 = copy.z(i), v0 = copy.v(i), a0 = copy.a(i), j0 = jerks[i];
+						C const v1 = v0 + h / 2 * (a0 + a1) + h * h / 12 * (j0 - j1);
+						C const z1 = z0 + h / 2 * (v0 + v1) + h * h / 12 * (a0 - a1);
+						copy.set_z(i, z1), copy.set_v(i, v1), copy.set_a(i, a1);
+						jerks[i] = j1;
+						ticks[i] = T;
+
+						// The second and third derivatives of the acceleration (at the end of the
+						// step) from the Hermite interpolant, for Aarseth's criterion.
+						C const a3 = (12. * (a0 - a1) + 6 * h * (j0 + j1)) / (h * h * h);
+						C const a2 = (-6. * (a0 - a1) - h * (4. * j0 + 2. * j1)) / (h * h) + h * a3;
+						double const A = std::abs(a1), A1 = std::abs(j1), A2 = std::abs(a2), A3 = std::abs(a3);
+						double const dt = std::sqrt(par.eta * (A * A2 + A1 * A1) / (A1 * A3 + A2 * A2));
+						// Finer right away; coarser by one level, and only where the coarser steps begin.
+						int const wanted = level(dt);
+						if (wanted > levels[i]) levels[i] = wanted;
+						else if (wanted < levels[i] && T % (2 * span) == 0) levels[i]--;
+						// (Those at the top level are at the end of the block.)
+						else if (!levels[i])
+						{
+							if (dt >= 2 * par.dt) votes[worker].go_coarser = true;
+							else votes[worker].stay = true;
+						}
+					}
+				});
+		}
+		std::swap(tab, copy);
+
+		// Adjust the block itself, as in `subcycle`.
+		bool go_coarser{}, stay{};
+		for (auto const& v : votes)
+			go_coarser |= v.go_coarser, stay |= v.stay, stats.evaluations += v.evaluations;
+		if (N && *std::min_element(levels.begin(), levels.end()) > 0)
+		{
+			par.dt = std::max(par.low_dt, par.dt / 2);
+			for (auto& k : levels) k--;
+		}
+		else if (go_coarser && !stay && par.dt * 2 <= par.high_dt)
+		{
+			par.dt *= 2;
+			for (auto& k : levels) if (k) k++;
+		}
+	}
+
+	template <class Force, class Judge, class Integrator>
+	void Dyn::subcycle(Force const& force, Judge const& judge, Integrator const& integrate)
+	{
+		int const N = n();
+		// Number of levels below the block. The finest step (a "tick") is still at least `low_dt`.
+		int K = 0;
+		while (K < 30 && par.dt / (1 << (K + 1)) >= par.low_dt) K++;
+		double const tick = par.dt / (1 << K);
+		levels.resize(N);
+		for (auto& k : levels) k = std::min(k, K);
+
+		// Votes of each worker about the whole block (see below).
+		struct Votes { bool go_coarser{}, stay{}; long long evaluations{}, retries{}; char padding[40]; };
+		std::vector<Votes> votes(concurrency());
+
+		// `copy` holds the state of each particle at its own time, `ticks[i]` ticks
+		// into the block. `tab` holds everyone predicted to the current tick.
+		copy = tab;
+		std::vector<int> ticks(N), due;
+		for (int T = 0; T < 1 << K;)
+		{
+			due.clear();
+			for (int i = 0; i < N; i++) if (ticks[i] == T) due.push_back(i);
+
+			// Predict (to second order) the particles that are not due.
+			parallel(N, [&](int begin, int end, int)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						double const d = (T - ticks[i]) * tick;
+						tab.set_z(i, copy.z(i) + d * copy.v(i) + d * d / 2 * copy.a(i));
+						tab.set_v(i, copy.v(i) + d * copy.a(i));
+					}
+				});
+			prepare(policy::active(force));
+
+			parallel((int)due.size(), [&](int begin, int end, int worker)
+				{
+					for (int k = begin; k < end; k++)
+					{
+						int const i = due[k];
+						Entry const start = copy[i];
+						int motivation = 4;
+						bool go_finer, go_coarser;
+						beasons::BeasonsResults aa;
+						for (;;)
+						{
+							auto accel = [&](C const& z, C const&) { votes[worker].evaluations++; return accelerate(i, z, force); };
+							aa = integrate(par.dt / (1 << levels[i]), accel, start.z, start.v, start.a);
+
+							// Same judgement as in `advance`, but of this particle's level.
+							int const jz = judge.z(aa.y0_strong, aa.y0_weak), jv = judge.v(aa.y1_strong, aa.y1_weak);
+							go_finer = jz < 0 || jv < 0;
+							go_coarser = !go_finer && (jz > 0 || jv > 0);
+							if (go_finer && levels[i] < K && --motivation)
+							{
+								levels[i]++, votes[worker].retries++;
+								continue;
+							}
+							break;
+						}
+
+						copy.set_z(i, aa.y0_strong);
+						copy.set_v(i, aa.y1_strong);
+						copy.set_a(i, aa.y2);
+						int const span = 1 << (K - levels[i]);
+						ticks[i] += span;
+						// Only go coarser where the coarser steps begin.
+						if (!levels[i])
+						{
+							if (go_coarser) votes[worker].go_coarser = true;
+							else votes[worker].stay = true;
+						}
+						else if (go_coarser && ticks[i] % (2 * span) == 0)
+							levels[i]--;
+					}
+				});
+
+			T = *std::min_element(ticks.begin(), ticks.end());
+		}
+		std::swap(tab, copy);
+
+		// Adjust the block itself, keeping the steps of the particles the same
+		// (except for those at the top level that want to go coarser).
+		bool go_coarser{}, stay{};
+		for (auto const& v : votes)
+			go_coarser |= v.go_coarser, stay |= v.stay, stats.evaluations += v.evaluations, stats.retries += v.retries;
+		if (N && *std::min_element(levels.begin(), levels.end()) > 0)
+		{
+			par.dt = std::max(par.low_dt, par.dt / 2);
+			for (auto& k : levels) k--;
+		}
+		else if (go_coarser && !stay && par.dt * 2 <= par.high_dt)
+		{
+			par.dt *= 2;
+			for (auto& k : levels) if (k) k++;
+		}
+	}
+
+	/// <summary>
+	/// Compute the acceleration felt by particle at index `i` if it were at
+	/// the hypothetical location z.
+	/// </summary>
+	/// <param name="i">Valid index of the particle</param>
+	/// <param name="z">The particle's hypothetical location</param>
+	/// <param name="force">The pair force</param>
+	/// <returns>Acceleration, or force divided by the particle's mass</returns>
+	template <class Force>
+	C Dyn::accelerate(int i, C const& z, Force const& force) const
+	{
+		if (!policy::active(force)) return 0;
+		Entry e = tab[i];
+		e.z = z;
+		C f;
+		if (!drv.gravity)
+		{
+			for (int j = n() - 1; j >= 0; j--) if (i != j) f += force(e, tab.source(j));
+			return f / e.m;
+		}
+
+		// The pair force agrees with the inverse-square law, which the engine sums,
+		// except for the particles that overlap this one. Those are found
+		// on the lists of contacts if they are certain to be there.
+		bool const listed = contacts.built() && contacts.covers(i, z);
+		C a;
+		// A particle that the engine didn't sum.
+		auto near = [&](int j)
+			{
+				double const dx = tab.x[j] - z.real(), dy = tab.y[j] - z.imag();
+				if (grid::overlap(dx, dy, e.r + tab.r[j]))
+				{
+					if (!listed) f += force(e, tab.source(j));
+					return;
+				}
+				double const d2 = dx * dx + dy * dy;
+				C const g = drv.gravity * tab.m[j] / (d2 * sqrt(d2)) * C(dx, dy);
+				if (finite(g)) a += g;
+			};
+		if (quad.built())
+		{
+			// Distant groups are summarized by the tree; the rest are handed back.
+			C const far = quad.field(i, z, e.r, near);
+			a += far;
+		}
+		else if (multipole.built())
+		{
+			C const far = multipole.field(i, z, e.r, near);
+			a += far;
+		}
+		else
+		{
+			// Sum with the vectorized kernel, block by block.
+			int constexpr B = 512;
+			int deferred[B], count;
+			kernel::Sources const s{ tab.x.data(), tab.y.data(), tab.m.data(), tab.r.data() };
+			kernel::SourcesF const sf{ fx.data(), fy.data(), fm.data(), fr.data() };
+			bool const mixed = !fm.empty();
+			for (int b = 0; b < n(); b += B)
+			{
+				C const far = mixed
+					? kernel::gravity(sf, b, std::min(n(), b + B), i, z - origin, e.r, drv.gravity, deferred, count)
+					: kernel::gravity(s, b, std::min(n(), b + B), i, z, e.r, drv.gravity, deferred, count);
+				a += far;
+				for (int k = 0; k < count; k++) near(deferred[k]);
+			}
+		}
+		if (listed)
+		{
+			int const* js = contacts.near(i);
+			for (int k = contacts.count(i) - 1; k >= 0; k--)
+				if (grid::overlap(tab.x[js[k]] - z.real(), tab.y[js[k]] - z.imag(), e.r + tab.r[js[k]]))
+					f += force(e, tab.source(js[k]));
+		}
+		return a + f / e.m;
+	}
+
+	template <class Force>
+	void Dyn::differentiate(int i, C& a, C& jerk, Force const& force) const
+	{
+		a = jerk = 0;
+		if (!policy::active(force)) return;
+		Entry const e = tab[i];
+		C f;
+		if (!drv.gravity)
+		{
+			for (int j = n() - 1; j >= 0; j--) if (i != j) f += force(e, tab.source(j));
+			a = f / e.m;
+			return;
+		}
+
+		// As in `accelerate`, with the kernel that also sums the jerk.
+		bool const listed = contacts.built() && contacts.covers(i, e.z);
+		int constexpr B = 512;
+		int deferred[B], count;
+		kernel::Sources const s{ tab.x.data(), tab.y.data(), tab.m.data(), tab.r.data() };
+		for (int b = 0; b < n(); b += B)
+		{
+			C j;
+			a += kernel::gravity(s, tab.vx.data(), tab.vy.data(), b, std::min(n(), b + B), i, e.z, e.v, e.r, drv.gravity, j, deferred, count);
+			jerk += j;
+			for (int k = 0; k < count; k++)
+			{
+				int const o = deferred[k];
+				double const dx = tab.x[o] - e.z.real(), dy = tab.y[o] - e.z.imag();
+				if (grid::overlap(dx, dy, e.r + tab.r[o]))
+				{
+					if (!listed) f += force(e, tab.source(o));
+					continue;
+				}
+				double const d2 = dx * dx + dy * dy, du = tab.vx[o] - e.v.real(), dv = tab.vy[o] - e.v.imag();
+				double const w = drv.gravity * tab.m[o] / (d2 * sqrt(d2)), c = 3 * (dx * du + dy * dv) / d2;
+				if (!std::isfinite(w)) continue;
+				a += w * C(dx, dy), jerk += w * C(du - c * dx, dv - c * dy);
+			}
+		}
+		if (listed)
+		{
+			int const* js = contacts.near(i);
+			for (int k = contacts.count(i) - 1; k >= 0; k--)
+				if (grid::overlap(tab.x[js[k]] - e.z.real(), tab.y[js[k]] - e.z.imag(), e.r + tab.r[js[k]]))
+					f += force(e, tab.source(js[k]));
+		}
+		a += f / e.m;
+	}
+}
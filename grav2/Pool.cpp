@@ -0,0 +1,146 @@
+#include "Pool.h"
+#include <algorithm>
+
+using namespace pool;
+
+namespace
+{
+	/// <summary>
+	/// Count the workers to have for `threads` (all hardware threads if not positive).
+	/// </summary>
+	int workers(int threads)
+	{
+		if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+		return std::max(1, threads);
+	}
+}
+
+Pool::Pool(int threads)
+	: queues(workers(threads))
+{
+	threads = size();
+	// Worker 0 is whoever calls `run`.
+	for (int w = 1; w < threads; w++) this->threads.emplace_back(&Pool::loop, this, w);
+}
+
+Pool::~Pool()
+{
+	{
+		std::lock_guard<std::mutex> lk(mu);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto& t : threads) t.join();
+}
+
+std::shared_ptr<Pool> const& Pool::shared()
+{
+	static std::shared_ptr<Pool> const pool = std::make_shared<Pool>();
+	return pool;
+}
+
+void Pool::run(int n, Body const& body, int grain)
+{
+	if (n <= 0) return;
+	if (size() == 1 || n == 1)
+	{
+		body(0, n, 0);
+		return;
+	}
+	// By default, split a worker's share about 8 times so that there is
+	// something left to steal toward the end.
+	this->grain = grain > 0 ? grain : std::max(1, n / (8 * size()));
+	this->body = &body;
+	remaining = n;
+	// Deal out contiguous shares, one per worker.
+	for (int w = 0; w < size(); w++)
+	{
+		int const b = (int)((long long)n * w / size()), e = (int)((long long)n * (w + 1) / size());
+		if (e > b) push(w, Range(b, e));
+	}
+	{
+		std::lock_guard<std::mutex> lk(mu);
+		generation++;
+	}
+	wake.notify_all();
+	work(0);
+	std::unique_lock<std::mutex> lk(mu);
+	done.wait(lk, [&]() { return remaining.load() == 0; });
+}
+
+void Pool::push(int w, Range const& r)
+{
+	Queue& q = queues[w];
+	std::lock_guard<std::mutex> lk(q.mu);
+	q.ranges.push_back(r);
+}
+
+bool Pool::take(int w, Range& r)
+{
+	{
+		Queue& q = queues[w];
+		std::lock_guard<std::mutex> lk(q.mu);
+		if (!q.ranges.empty())
+		{
+			r = q.ranges.back();
+			q.ranges.pop_back();
+			return true;
+		}
+	}
+	for (int k = 1; k < size(); k++)
+	{
+		Queue& q = queues[(w + k) % size()];
+		std::lock_guard<std::mutex> lk(q.mu);
+		if (!q.ranges.empty())
+		{
+			r = q.ranges.front();
+			q.ranges.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void Pool::work(int w)
+{
+	Range r;
+	while (remaining.load() > 0)
+	{
+		if (!take(w, r))
+		{
+			// Others are still busy with their last ranges.
+			std::this_thread::yield();
+			continue;
+		}
+		// Keep the lower half; leave the upper half to be taken later (or stolen).
+		int const g = grain.load();
+		while (r.second - r.first > g)
+		{
+			int const mid = r.first + (r.second - r.first) / 2;
+			push(w, Range(mid, r.second));
+			r.second = mid;
+		}
+		(*body.load())(r.first, r.second, w);
+		int const count = r.second - r.first;
+		if (remaining.fetch_sub(count) == count)
+		{
+			std::lock_guard<std::mutex> lk(mu);
+			done.notify_all();
+		}
+	}
+}
+
+void Pool::loop(int w)
+{
+	unsigned long long seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lk(mu);
+			wake.wait(lk, [&]() { return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+		}
+		work(w);
+	}
+}
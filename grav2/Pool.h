@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Table.h"
+
+/// <summary>
+/// A pool of threads for data-parallel loops.
+/// </summary>
+namespace pool
+{
+	/// <summary>
+	/// Work-stealing thread pool for loops over a range of indices.
+	///
+	/// Each thread owns a queue of index ranges. A thread takes the most
+	/// recently queued range of its own queue, and keeps splitting it in half,
+	/// queueing the upper halves, until it is small enough to process. Idle
+	/// threads steal the oldest (largest) ranges from the others. The calling
+	/// thread takes part in the work.
+	/// </summary>
+	class Pool
+	{
+	public:
+		/// <summary>
+		/// A process for the indices in [begin, end), run by the worker (thread)
+		/// numbered `worker`, between 0 (inclusive) and `size()` (exclusive).
+		/// </summary>
+		typedef std::function<void(int begin, int end, int worker)> Body;
+
+		/// <summary>
+		/// Start the threads.
+		/// </summary>
+		/// <param name="threads">Number of workers including the calling thread,
+		/// or 0 to use all hardware threads</param>
+		explicit Pool(int threads = 0);
+
+		/// <summary>
+		/// Stop and join the threads.
+		/// </summary>
+		~Pool();
+
+		Pool(Pool const&) = delete;
+		Pool& operator=(Pool const&) = delete;
+
+		/// <summary>
+		/// Count the number of workers (including the calling thread).
+		/// </summary>
+		int size() const { return (int)queues.size(); }
+
+		/// <summary>
+		/// Run `body` over all indices in [0, n), and wait until finished.
+		///
+		/// Not reentrant: don't call `run` from within `body`.
+		/// </summary>
+		/// <param name="n">Number of indices</param>
+		/// <param name="body">Process to be run on disjoint ranges of indices</param>
+		/// <param name="grain">Largest range given to `body` at once, or 0 to choose automatically</param>
+		void run(int n, Body const& body, int grain = 0);
+
+		/// <summary>
+		/// Recall the process-wide pool using all hardware threads.
+		/// </summary>
+		static std::shared_ptr<Pool> const& shared();
+
+	private:
+		typedef std::pair<int, int> Range;
+
+		/// <summary>
+		/// Queue of ranges owned by a worker (on its own cache line).
+		/// </summary>
+		struct alignas(64) Queue
+		{
+			std::mutex mu;
+			std::deque<Range> ranges;
+		};
+
+		/// <summary>
+		/// (Allocated aligned, which `new` doesn't promise for over-aligned types before C++17.)
+		/// </summary>
+		std::vector<Queue, dyn::Aligned<Queue>> queues;
+		std::vector<std::thread> threads;
+
+		/// <summary>
+		/// Guards `generation` and `quit`, and is used for waking up and finishing.
+		/// </summary>
+		std::mutex mu;
+		std::condition_variable wake, done;
+		unsigned long long generation{};
+		bool quit{};
+
+		/// <summary>
+		/// The current loop: its body, grain, and the number of indices not yet processed.
+		/// </summary>
+		std::atomic<Body const*> body{ nullptr };
+		std::atomic<int> grain{ 1 };
+		std::atomic<int> remaining{ 0 };
+
+		/// <summary>
+		/// Queue a range in the queue of the worker `w`.
+		/// </summary>
+		void push(int w, Range const& r);
+
+		/// <summary>
+		/// Take the most recent range from the own queue, or else steal the oldest range
+		/// from somebody else's. Return false if there's nothing to take.
+		/// </summary>
+		bool take(int w, Range& r);
+
+		/// <summary>
+		/// Process ranges until the current loop is finished.
+		/// </summary>
+		void work(int w);
+
+		/// <summary>
+		/// Main loop of the worker `w` (a thread other than the calling thread).
+		/// </summary>
+		void loop(int w);
+	};
+}
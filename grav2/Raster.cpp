@@ -0,0 +1,216 @@
+#include "Raster.h"
+#include <algorithm>
+
+using namespace raster;
+
+Disk raster::look(snap::Snapshot const& s, int i)
+{
+	C const z = s.z(i);
+	double const m = s.m[i], r = s.r[i];
+	double score = (m / s.mass) / (r * r * PI64 / s.area);
+	score = score / (1 + score);
+	Disk d;
+	d.alpha = (std::uint8_t)std::max(50., std::min(250., score * 256));
+	// Squish (tanh(x) / x tends to 1 at the origin).
+	double const dist = abs(z);
+	double const ratio = dist > 0 ? 250. * tanh(dist / 250.) / dist : 1;
+	d.z = ratio * z;
+	d.r = std::min(ratio * r, r * .5);
+	return d;
+}
+
+void Renderer::render(snap::Snapshot const& s, Image& image)
+{
+	int const W = options.width, H = options.height, T = options.tile;
+	int const columns = (W + T - 1) / T, rows = (H + T - 1) / T, tiles = columns * rows;
+	float const zoom = (float)options.zoom;
+	image.width = W, image.height = H;
+	image.rgba.resize((size_t)W * H * 4);
+
+	// To the screen, in the order of drawing (the window draws the last particle first).
+	int const n = s.n();
+	spots.resize(n);
+	for (int k = 0; k < n; k++)
+	{
+		Disk const d = look(s, n - 1 - k);
+		spots[k] = Spot{ (float)d.z.real() * zoom + W / 2.f, (float)d.z.imag() * zoom + H / 2.f,
+			(float)d.r * zoom, d.alpha / 255.f };
+	}
+
+	// Bin: count the disks of each tile, then list them (in order) where the counts say.
+	// A disk reaches a pixel up to a pixel beyond its radius (the edge, and the outline).
+	auto bounds = [&](Spot const& p, int& c0, int& c1, int& r0, int& r1)
+		{
+			float const reach = p.r + 1;
+			auto clamp = [](float v, int hi) { return (int)std::max(0.f, std::min(v, (float)hi)); };
+			c0 = clamp(floor((p.x - reach) / T), columns), c1 = clamp(floor((p.x + reach) / T) + 1, columns);
+			r0 = clamp(floor((p.y - reach) / T), rows), r1 = clamp(floor((p.y + reach) / T) + 1, rows);
+		};
+	begin.assign(tiles + 1, 0);
+	for (Spot const& p : spots)
+	{
+		int c0, c1, r0, r1;
+		bounds(p, c0, c1, r0, r1);
+		for (int row = r0; row < r1; row++)
+			for (int c = c0; c < c1; c++) begin[row * columns + c + 1]++;
+	}
+	for (int k = 0; k < tiles; k++) begin[k + 1] += begin[k];
+	binned.resize(begin[tiles]);
+	std::vector<int> fill(begin.begin(), begin.end() - 1);
+	for (int k = 0; k < n; k++)
+	{
+		int c0, c1, r0, r1;
+		bounds(spots[k], c0, c1, r0, r1);
+		for (int row = r0; row < r1; row++)
+			for (int c = c0; c < c1; c++) binned[fill[row * columns + c]++] = k;
+	}
+
+	// Draw each tile on its own: in gray levels (black over white), from white.
+	auto draw = [&](int first, int last, int)
+		{
+			std::vector<float> gray((size_t)T * T);
+			for (int k = first; k < last; k++)
+			{
+				int const x0 = k % columns * T, y0 = k / columns * T;
+				int const x1 = std::min(W, x0 + T), y1 = std::min(H, y0 + T);
+				std::fill(gray.begin(), gray.end(), 1.f);
+				for (int b = begin[k]; b < begin[k + 1]; b++)
+				{
+					Spot const& p = spots[binned[b]];
+					float const reach = p.r + 1;
+					int const px0 = std::max(x0, (int)floor(p.x - reach)), px1 = std::min(x1, (int)ceil(p.x + reach));
+					int const py0 = std::max(y0, (int)floor(p.y - reach)), py1 = std::min(y1, (int)ceil(p.y + reach));
+					for (int py = py0; py < py1; py++)
+					{
+						float const dy = py + .5f - p.y;
+						float* g = &gray[(size_t)(py - y0) * T];
+						for (int px = px0; px < px1; px++)
+						{
+							float const dx = px + .5f - p.x;
+							float const d = sqrt(dx * dx + dy * dy);
+							// Coverage of the outline (a pixel wide) and then of the disk,
+							// each blended over what's there.
+							float const outline = std::max(0.f, 1 - std::abs(d - p.r));
+							float const disk = std::max(0.f, std::min(1.f, p.r + .5f - d));
+							g[px - x0] *= (1 - p.alpha * outline) * (1 - p.alpha * disk);
+						}
+					}
+				}
+				for (int py = y0; py < y1; py++)
+				{
+					float const* g = &gray[(size_t)(py - y0) * T];
+					std::uint8_t* out = &image.rgba[((size_t)py * W + x0) * 4];
+					for (int px = x0; px < x1; px++, out += 4)
+					{
+						std::uint8_t const v = (std::uint8_t)(g[px - x0] * 255 + .5f);
+						out[0] = out[1] = out[2] = v, out[3] = 255;
+					}
+				}
+			}
+		};
+	if (workers) workers->run(tiles, draw, 1);
+	else draw(0, tiles, 0);
+}
+
+namespace
+{
+	/// <summary>
+	/// Writes the chunks of a PNG file, with their lengths and checksums.
+	/// </summary>
+	struct Png
+	{
+		std::FILE* file;
+		bool ok{ true };
+
+		static std::uint32_t crc(std::uint32_t c, std::uint8_t const* p, size_t n)
+		{
+			static std::uint32_t const* const table = []
+				{
+					static std::uint32_t t[256];
+					for (std::uint32_t k = 0; k < 256; k++)
+					{
+						std::uint32_t c = k;
+						for (int b = 0; b < 8; b++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+						t[k] = c;
+					}
+					return t;
+				}();
+			c = ~c;
+			for (size_t k = 0; k < n; k++) c = table[(c ^ p[k]) & 0xFF] ^ (c >> 8);
+			return ~c;
+		}
+
+		static void big(std::uint8_t* p, std::uint32_t v)
+		{
+			p[0] = (std::uint8_t)(v >> 24), p[1] = (std::uint8_t)(v >> 16), p[2] = (std::uint8_t)(v >> 8), p[3] = (std::uint8_t)v;
+		}
+
+		void write(void const* p, size_t n)
+		{
+			ok = ok && std::fwrite(p, 1, n, file) == n;
+		}
+
+		void chunk(char const* type, std::vector<std::uint8_t> const& data)
+		{
+			std::uint8_t head[8], tail[4];
+			big(head, (std::uint32_t)data.size());
+			std::copy(type, type + 4, head + 4);
+			big(tail, crc(crc(0, head + 4, 4), data.data(), data.size()));
+			write(head, 8), write(data.data(), data.size()), write(tail, 4);
+		}
+	};
+}
+
+bool raster::save_png(char const* path, Image const& image)
+{
+	std::FILE* const file = std::fopen(path, "wb");
+	if (!file) return false;
+	Png png{ file };
+	static std::uint8_t const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png.write(signature, 8);
+
+	std::vector<std::uint8_t> header(13);
+	Png::big(&header[0], image.width), Png::big(&header[4], image.height);
+	header[8] = 8, header[9] = 6; // 8 bits per channel, RGBA (and the rest 0)
+	png.chunk("IHDR", header);
+
+	// Rows, each after its filter type (0: none), in a zlib stream of stored blocks.
+	size_t const stride = (size_t)image.width * 4, size = (stride + 1) * image.height;
+	size_t constexpr block = 65535;
+	std::vector<std::uint8_t> data;
+	data.reserve(2 + size + (size / block + 1) * 5 + 4);
+	data.push_back(0x78), data.push_back(0x01);
+	std::uint32_t a = 1, b = 0; // Adler-32
+	size_t left = 0, row = 0, column = stride; // Bytes left in the block, row and column of the image
+	for (size_t k = 0; k < size; k++)
+	{
+		if (!left)
+		{
+			left = std::min(block, size - k);
+			std::uint16_t const len = (std::uint16_t)left, nlen = (std::uint16_t)~len;
+			data.push_back(k + left == size); // last?
+			data.push_back((std::uint8_t)len), data.push_back((std::uint8_t)(len >> 8));
+			data.push_back((std::uint8_t)nlen), data.push_back((std::uint8_t)(nlen >> 8));
+		}
+		std::uint8_t byte;
+		if (column == stride) byte = 0, column = 0;
+		else
+		{
+			byte = image.rgba[row * stride + column++];
+			if (column == stride) row++;
+		}
+		data.push_back(byte);
+		a = (a + byte) % 65521, b = (b + a) % 65521;
+		left--;
+	}
+	data.resize(data.size() + 4);
+	Png::big(&data[data.size() - 4], b << 16 | a);
+	png.chunk("IDAT", data);
+	png.chunk("IEND", {});
+	return std::fclose(file) == 0 && png.ok;
+}
+
+bool raster::append_raw(std::FILE* file, Image const& image)
+{
+	return std::fwrite(image.rgba.data(), 1, image.rgba.size(), file) == image.rgba.size();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "Include.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "Pool.h"
+#include "Snapshot.h"
+
+/// <summary>
+/// Drawing snapshots without a window (or a GPU), for rendering frames in batch.
+///
+/// The picture is the window's (Source.cpp): each particle is a disk, darker
+/// the denser it is, at its position squished toward the origin (see `look`),
+/// drawn in black over white. The screen is divided into square tiles; each
+/// disk is listed (binned) in the tiles that it touches, and then the tiles
+/// are drawn in parallel, each on its own, disk by disk in the order of
+/// the window. The edges of the disks are antialiased.
+/// </summary>
+namespace raster
+{
+	/// <summary>
+	/// How a particle looks: a disk on the plane, and its opacity.
+	/// </summary>
+	struct Disk
+	{
+		/// <summary>
+		/// Center (L) and radius (L), after the squish.
+		/// </summary>
+		C z;
+		double r{};
+		/// <summary>
+		/// Opacity (0 to 255).
+		/// </summary>
+		std::uint8_t alpha{};
+	};
+
+	/// <summary>
+	/// Compute how the particle `i` of `s` looks.
+	///
+	/// The opacity scores the density of the particle against that of all
+	/// (mass over area, each as a fraction of the total), x / (1 + x), within [50, 250].
+	/// The plane is squished so that everything fits: a point at distance d from
+	/// the origin is drawn at 250 tanh(d / 250), with the radius scaled alike (and
+	/// at most halved).
+	/// </summary>
+	Disk look(snap::Snapshot const& s, int i);
+
+	/// <summary>
+	/// Image in 8-bit RGBA (not premultiplied), row by row from the top.
+	/// </summary>
+	struct Image
+	{
+		int width{}, height{};
+		std::vector<std::uint8_t> rgba;
+	};
+
+	/// <summary>
+	/// Options of `Renderer`.
+	/// </summary>
+	struct Options
+	{
+		/// <summary>
+		/// Size of the image (pixels).
+		/// </summary>
+		int width{ 600 }, height{ 600 };
+
+		/// <summary>
+		/// Pixels per unit of length (L); the origin is at the center of the image.
+		/// </summary>
+		double zoom{ 1 };
+
+		/// <summary>
+		/// Width and height of a tile (pixels).
+		/// </summary>
+		int tile{ 32 };
+	};
+
+	/// <summary>
+	/// Draws snapshots into images, on `workers` (or on the calling thread, if none).
+	/// Keeps its memory from one frame to the next.
+	/// </summary>
+	class Renderer
+	{
+	public:
+		Options options;
+		std::shared_ptr<pool::Pool> workers;
+
+		/// <summary>
+		/// Draw `s` into `image` (resized to the size of the options).
+		/// </summary>
+		void render(snap::Snapshot const& s, Image& image);
+
+	private:
+		/// <summary>
+		/// A disk on the screen: center and radius (pixels), and opacity (0 to 1).
+		/// </summary>
+		struct Spot { float x, y, r, alpha; };
+
+		std::vector<Spot> spots;
+
+		/// <summary>
+		/// Disks in each tile, in the order of drawing (compressed rows:
+		/// those of tile k are `binned[begin[k]]` to `binned[begin[k + 1] - 1]`).
+		/// </summary>
+		std::vector<int> begin, binned;
+	};
+
+	/// <summary>
+	/// Write `image` to the file at `path` in PNG (8-bit RGBA). The pixels are
+	/// not compressed (stored as such in the deflate stream), which is fast, and
+	/// leaves the compressing to whatever encodes the frames afterward.
+	/// </summary>
+	/// <returns>Whether it was written</returns>
+	bool save_png(char const* path, Image const& image);
+
+	/// <summary>
+	/// Append the pixels of `image` to `file` as they are (raw RGBA, as taken by
+	/// e.g. `ffmpeg -f rawvideo -pix_fmt rgba -s WxH`).
+	/// </summary>
+	/// <returns>Whether they were written</returns>
+	bool append_raw(std::FILE* file, Image const& image);
+}
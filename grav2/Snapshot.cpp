@@ -0,0 +1,34 @@
+#include "Snapshot.h"
+
+using namespace snap;
+
+void Snapshot::capture(dyn::Dyn const& dyn)
+{
+	auto const& tab = dyn.tab;
+	step = dyn.stats.steps, time = dyn.stats.time;
+	dt = dyn.par.dt;
+	mass = dyn.mass(), area = dyn.area();
+	x.assign(tab.x.begin(), tab.x.end());
+	y.assign(tab.y.begin(), tab.y.end());
+	m.assign(tab.m.begin(), tab.m.end());
+	r.assign(tab.r.begin(), tab.r.end());
+	kinetic = 0;
+	for (int i = dyn.n() - 1; i >= 0; i--)
+		kinetic += std::norm(tab.v(i)) * tab.m[i];
+	kinetic /= 2;
+}
+
+void Snapshot::capture(dyn::Dyn const& dyn, double t)
+{
+	capture(dyn);
+	time = t;
+	kinetic = 0;
+	for (int i = dyn.n() - 1; i >= 0; i--)
+	{
+		C z, v;
+		dyn.interpolate(i, t, z, v);
+		x[i] = z.real(), y[i] = z.imag();
+		kinetic += std::norm(v) * m[i];
+	}
+	kinetic /= 2;
+}
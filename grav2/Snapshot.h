@@ -0,0 +1,111 @@
+#pragma once
+#include "Include.h"
+#include <atomic>
+#include <vector>
+#include "Dyn.h"
+
+/// <summary>
+/// Handing the state of a simulation over from the thread that runs it to
+/// another thread (e.g., the renderer) without either one waiting for the other.
+/// </summary>
+namespace snap
+{
+	/// <summary>
+	/// What the renderer needs of the state of a simulation at one time
+	/// (a copy of some of the columns of the table, and a few totals).
+	/// </summary>
+	struct Snapshot
+	{
+		/// <summary>
+		/// Number of steps and simulated time (T) (see `dyn::Dyn::Stats`).
+		/// </summary>
+		long long step{};
+		double time{};
+
+		/// <summary>
+		/// Time step (T) for the next step.
+		/// </summary>
+		double dt{};
+
+		/// <summary>
+		/// Kinetic energy (M L L/T/T).
+		/// </summary>
+		double kinetic{};
+
+		/// <summary>
+		/// Total mass (M) and area (L L) of the particles (see `dyn::Dyn::mass`).
+		/// </summary>
+		double mass{}, area{};
+
+		/// <summary>
+		/// Position (L), mass (M), radius (L), indexed like the table.
+		/// </summary>
+		std::vector<double> x, y, m, r;
+
+		int n() const { return (int)m.size(); }
+		C z(int i) const { return C(x[i], y[i]); }
+
+		/// <summary>
+		/// Copy the state of `dyn` (reusing the memory already held).
+		/// </summary>
+		void capture(dyn::Dyn const& dyn);
+
+		/// <summary>
+		/// Like `capture`, but interpolate the positions to the time `t` (T) within
+		/// the last step (see `dyn::Dyn::interpolate`).
+		/// </summary>
+		void capture(dyn::Dyn const& dyn, double t);
+	};
+
+	/// <summary>
+	/// Lock-free triple buffer: a single writer fills one slot while the
+	/// single reader looks at another; the third holds the latest complete one.
+	/// Publishing and picking up exchange slots with the third (atomically), so
+	/// neither side ever waits, and the reader always gets the latest complete
+	/// slot (those it didn't get to are skipped).
+	/// </summary>
+	template <class T>
+	class TripleBuffer
+	{
+	public:
+		/// <summary>
+		/// (Writer.) Recall the slot to fill.
+		/// </summary>
+		T& back() { return slots[write]; }
+
+		/// <summary>
+		/// (Writer.) Publish the slot just filled; `back` is then another slot.
+		/// </summary>
+		void publish() { write = middle.exchange(write | fresh, std::memory_order_acq_rel) & mask; }
+
+		/// <summary>
+		/// (Reader.) Pick up the latest slot published, if there's a new one.
+		/// </summary>
+		/// <returns>Whether `front` changed</returns>
+		bool update()
+		{
+			if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+			read = middle.exchange(read, std::memory_order_acq_rel) & mask;
+			return true;
+		}
+
+		/// <summary>
+		/// (Reader.) Recall the slot picked up by `update` (it stays as is until then).
+		/// </summary>
+		T const& front() const { return slots[read]; }
+
+	private:
+		static constexpr int mask = 3, fresh = 4;
+
+		T slots[3];
+		/// <summary>
+		/// Slot of the writer, and of the reader (each its own).
+		/// </summary>
+		alignas(64) int write{ 0 };
+		alignas(64) int read{ 1 };
+		/// <summary>
+		/// The third slot, with `fresh` if it was published since the reader last picked one up.
+		/// </summary>
+		alignas(64) std::atomic<int> middle{ 2 };
+	};
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include "Include.h"
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace dyn
+{
+	/// <summary>
+	/// Allocator of memory aligned to `A` bytes (for SIMD loads and
+	/// to start each column on its own cache line).
+	/// </summary>
+	template <class T, std::size_t A = 64>
+	struct Aligned
+	{
+		typedef T value_type;
+
+		template <class U> struct rebind { typedef Aligned<U, A> other; };
+
+		Aligned() = default;
+		template <class U> Aligned(Aligned<U, A> const&) {}
+
+		T* allocate(std::size_t n)
+		{
+			void* p{};
+#ifdef _MSC_VER
+			p = _aligned_malloc(n * sizeof(T), A);
+#else
+			if (posix_memalign(&p, A, n * sizeof(T))) p = nullptr;
+#endif
+			if (!p) throw std::bad_alloc();
+			return (T*)p;
+		}
+
+		void deallocate(T* p, std::size_t)
+		{
+#ifdef _MSC_VER
+			_aligned_free(p);
+#else
+			free(p);
+#endif
+		}
+
+		template <class U> bool operator==(Aligned<U, A> const&) const { return true; }
+		template <class U> bool operator!=(Aligned<U, A> const&) const { return false; }
+	};
+
+	/// <summary>
+	/// Dynamical table in the "structure of arrays" layout: each property
+	/// of the particles (a column) is stored in its own contiguous,
+	/// aligned array, so that a loop only streams the columns that it needs.
+	///
+	/// A whole row can still be read or written as an entry (`E`), which must have
+	/// the members `C z, v, a` and `double m, r`.
+	/// </summary>
+	template <class E>
+	class Table
+	{
+	public:
+		typedef std::vector<double, Aligned<double>> Column;
+
+		/// <summary>
+		/// Position (L).
+		/// </summary>
+		Column x, y;
+		/// <summary>
+		/// Velocity (L/T).
+		/// </summary>
+		Column vx, vy;
+		/// <summary>
+		/// Acceleration (L/T/T).
+		/// </summary>
+		Column ax, ay;
+		/// <summary>
+		/// Mass (M), radius (L).
+		/// </summary>
+		Column m, r;
+
+		/// <summary>
+		/// Count the number of rows (particles).
+		/// </summary>
+		int size() const { return (int)x.size(); }
+
+		/// <summary>
+		/// Decide whether there are no rows.
+		/// </summary>
+		bool empty() const { return x.empty(); }
+
+		/// <summary>
+		/// Change the number of rows. New rows are all zero.
+		/// </summary>
+		void resize(int n) { each([=](Column& c) { c.resize(n); }); }
+
+		/// <summary>
+		/// Reserve storage for the given number of rows.
+		/// </summary>
+		void reserve(int n) { each([=](Column& c) { c.reserve(n); }); }
+
+		/// <summary>
+		/// Remove all rows.
+		/// </summary>
+		void clear() { each([](Column& c) { c.clear(); }); }
+
+		/// <summary>
+		/// Remove the rows i for which `drop[i]` is true, keeping the others in order.
+		/// </summary>
+		void remove(std::vector<char> const& drop)
+		{
+			int const n = size();
+			each([&](Column& c)
+				{
+					int k = 0;
+					for (int i = 0; i < n; i++) if (!drop[i]) c[k++] = c[i];
+					c.resize(k);
+				});
+		}
+
+		/// <summary>
+		/// Append a row.
+		/// </summary>
+		void push_back(E const& e)
+		{
+			x.push_back(e.z.real()), y.push_back(e.z.imag());
+			vx.push_back(e.v.real()), vy.push_back(e.v.imag());
+			ax.push_back(e.a.real()), ay.push_back(e.a.imag());
+			m.push_back(e.m), r.push_back(e.r);
+		}
+
+		/// <summary>
+		/// Read a whole row.
+		/// </summary>
+		E operator[](int i) const
+		{
+			E e;
+			e.z = z(i), e.v = v(i), e.a = a(i);
+			e.m = m[i], e.r = r[i];
+			return e;
+		}
+
+		/// <summary>
+		/// Read only those columns of a row that are needed to compute the force
+		/// between particles: position, mass, and radius. The velocity and
+		/// the acceleration are left zero.
+		/// </summary>
+		E source(int i) const
+		{
+			E e;
+			e.z = z(i), e.m = m[i], e.r = r[i];
+			return e;
+		}
+
+		/// <summary>
+		/// Write a whole row.
+		/// </summary>
+		void set(int i, E const& e)
+		{
+			set_z(i, e.z), set_v(i, e.v), set_a(i, e.a);
+			m[i] = e.m, r[i] = e.r;
+		}
+
+		/// <summary>
+		/// Read the position (L).
+		/// </summary>
+		C z(int i) const { return C(x[i], y[i]); }
+		/// <summary>
+		/// Read the velocity (L/T).
+		/// </summary>
+		C v(int i) const { return C(vx[i], vy[i]); }
+		/// <summary>
+		/// Read the acceleration (L/T/T).
+		/// </summary>
+		C a(int i) const { return C(ax[i], ay[i]); }
+
+		/// <summary>
+		/// Write the position (L).
+		/// </summary>
+		void set_z(int i, C const& c) { x[i] = c.real(), y[i] = c.imag(); }
+		/// <summary>
+		/// Write the velocity (L/T).
+		/// </summary>
+		void set_v(int i, C const& c) { vx[i] = c.real(), vy[i] = c.imag(); }
+		/// <summary>
+		/// Write the acceleration (L/T/T).
+		/// </summary>
+		void set_a(int i, C const& c) { ax[i] = c.real(), ay[i] = c.imag(); }
+
+	private:
+		/// <summary>
+		/// Apply `f` to every column.
+		/// </summary>
+		template <class F>
+		void each(F const& f)
+		{
+			Column* cs[] = { &x, &y, &vx, &vy, &ax, &ay, &m, &r };
+			for (auto c : cs) f(*c);
+		}
+	};
+}
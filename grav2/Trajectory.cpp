@@ -0,0 +1,369 @@
+#include "Trajectory.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace traj;
+
+// Format (version 1), in the byte order of the machine that wrote it:
+//
+// 1. `FileHeader`.
+// 2. Frames, each a `FrameHeader` followed by `bytes` bytes of payload: the
+//    integers (see `Writer::write`) of the columns, column by column, each as
+//    the difference from the previous frame (or as it is, in a key frame),
+//    zigzag-encoded, in base-128 variable-length bytes (least significant first).
+// 3. The index: a `Mark` per frame, then `FileFooter`.
+
+namespace
+{
+	std::uint32_t constexpr version = 1;
+
+	char const magic[8] = { 'g', 'r', 'a', 'v', '2', 't', 'r', 'j' };
+	char const magic_index[8] = { 'g', 'r', 'a', 'v', '2', 'i', 'd', 'x' };
+	std::uint32_t constexpr magic_frame = 0x6d617266; // "fram"
+
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version, columns, precision, keyframes;
+		double quantum, vquantum;
+	};
+
+	struct FrameHeader
+	{
+		std::uint32_t magic, key;
+		std::int64_t step;
+		double time, zx, zy, vx, vy;
+		std::int32_t n, reserved;
+		std::uint64_t bytes;
+	};
+
+	struct FileFooter
+	{
+		std::uint64_t count, offset;
+		char magic[8];
+	};
+
+	/// <summary>
+	/// Count the integers per particle for the columns.
+	/// </summary>
+	int width(int columns)
+	{
+		return 2 * !!(columns & position) + 2 * !!(columns & velocity) + !!(columns & mass) + !!(columns & radius);
+	}
+
+	/// <summary>
+	/// Quantize `v` (relative to the barycenter) to fixed point,
+	/// saturating (and taking NaN to 0).
+	/// </summary>
+	std::int64_t quantize(double v, double quantum)
+	{
+		double const q = std::round(v / quantum), limit = 4e18;
+		return q == q ? (std::int64_t)std::max(-limit, std::min(q, limit)) : 0;
+	}
+
+	std::int64_t bits(double v) { std::int64_t w; std::memcpy(&w, &v, sizeof w); return w; }
+	double unbits(std::int64_t w) { double v; std::memcpy(&v, &w, sizeof v); return v; }
+
+	std::int64_t bits(float v) { std::int32_t w; std::memcpy(&w, &v, sizeof w); return w; }
+	float unbits32(std::int64_t w) { std::int32_t u = (std::int32_t)w; float v; std::memcpy(&v, &u, sizeof v); return v; }
+
+	void put(std::vector<char>& out, std::int64_t d)
+	{
+		// Zigzag: small magnitudes (of either sign) to small unsigned integers.
+		std::uint64_t u = (std::uint64_t)d << 1 ^ (std::uint64_t)(d >> 63);
+		for (; u >= 0x80; u >>= 7) out.push_back((char)((u & 0x7f) | 0x80));
+		out.push_back((char)u);
+	}
+
+	bool get(char const*& p, char const* end, std::int64_t& d)
+	{
+		std::uint64_t u{};
+		for (int shift = 0; p < end && shift < 64; shift += 7)
+		{
+			unsigned char const c = (unsigned char)*p++;
+			u |= (std::uint64_t)(c & 0x7f) << shift;
+			if (!(c & 0x80))
+			{
+				d = (std::int64_t)(u >> 1) ^ -(std::int64_t)(u & 1);
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+Writer::Writer(char const* path, Options const& options)
+	: options(options), file(path, std::ios::binary | std::ios::trunc)
+{
+	FileHeader h{};
+	std::memcpy(h.magic, magic, sizeof magic);
+	h.version = version, h.columns = (std::uint32_t)(options.columns & all);
+	h.precision = (std::uint32_t)options.precision, h.keyframes = (std::uint32_t)std::max(1, options.keyframes);
+	h.quantum = options.quantum, h.vquantum = options.vquantum;
+	file.write((char const*)&h, sizeof h);
+	failed = !file;
+	thread = std::thread([this]() { run(); });
+}
+
+Writer::~Writer()
+{
+	{
+		std::lock_guard<std::mutex> l(lock);
+		done = true;
+	}
+	wake.notify_one();
+	thread.join();
+	if (!file) return;
+	FileFooter f{};
+	f.count = index.size(), f.offset = (std::uint64_t)file.tellp();
+	std::memcpy(f.magic, magic_index, sizeof magic_index);
+	if (!index.empty()) file.write((char const*)index.data(), index.size() * sizeof(Mark));
+	file.write((char const*)&f, sizeof f);
+}
+
+bool Writer::good() const
+{
+	std::lock_guard<std::mutex> l(lock);
+	return !failed;
+}
+
+long long Writer::dropped() const
+{
+	std::lock_guard<std::mutex> l(lock);
+	return lost;
+}
+
+bool Writer::record(dyn::Dyn const& dyn)
+{
+	if (options.interval > 0)
+	{
+		// Every frame time passed in the last step (a little slack for the rounding of the time).
+		if (!calls++) next = (long long)std::ceil(dyn.began() / options.interval - 1e-9);
+		bool any{};
+		while (next * options.interval <= dyn.stats.time + 1e-9 * options.interval)
+			any |= capture(dyn, next++ * options.interval);
+		return any;
+	}
+	if (calls++ % std::max(1, options.every)) return false;
+	return capture(dyn, dyn.stats.time);
+}
+
+bool Writer::capture(dyn::Dyn const& dyn, double t)
+{
+	std::unique_ptr<Frame> f;
+	{
+		std::lock_guard<std::mutex> l(lock);
+		if (failed) return false;
+		if ((int)queue.size() >= options.backlog)
+		{
+			lost++;
+			return false;
+		}
+		if (!spare.empty()) f = std::move(spare.back()), spare.pop_back();
+	}
+	if (!f) f.reset(new Frame);
+
+	// Copy only; the rest is done on the thread.
+	int const c = f->columns = options.columns & all;
+	int const n = dyn.n();
+	f->step = dyn.stats.steps, f->time = t, f->n = n;
+	f->zcm = f->vcm = 0;
+	auto const& tab = dyn.tab;
+	auto copy = [](dyn::Dyn::V::Column const& from, std::vector<double>& to, bool wanted)
+		{
+			if (wanted) to.assign(from.begin(), from.end());
+			else to.clear();
+		};
+	copy(tab.m, f->m, c & mass), copy(tab.r, f->r, c & radius);
+	if (t == dyn.stats.time)
+	{
+		if (n) dyn.barycenter(f->zcm, f->vcm);
+		copy(tab.x, f->x, c & position), copy(tab.y, f->y, c & position);
+		copy(tab.vx, f->vx, c & velocity), copy(tab.vy, f->vy, c & velocity);
+	}
+	else
+	{
+		f->x.resize(c & position ? n : 0), f->y.resize(c & position ? n : 0);
+		f->vx.resize(c & velocity ? n : 0), f->vy.resize(c & velocity ? n : 0);
+		double mass{};
+		for (int i = 0; i < n; i++)
+		{
+			C z, v;
+			dyn.interpolate(i, t, z, v);
+			if (c & position) f->x[i] = z.real(), f->y[i] = z.imag();
+			if (c & velocity) f->vx[i] = v.real(), f->vy[i] = v.imag();
+			f->zcm += tab.m[i] * z, f->vcm += tab.m[i] * v, mass += tab.m[i];
+		}
+		if (mass) f->zcm /= mass, f->vcm /= mass;
+	}
+	{
+		std::lock_guard<std::mutex> l(lock);
+		queue.push_back(std::move(f));
+	}
+	wake.notify_one();
+	frames++;
+	return true;
+}
+
+void Writer::run()
+{
+	for (;;)
+	{
+		std::unique_ptr<Frame> f;
+		{
+			std::unique_lock<std::mutex> l(lock);
+			wake.wait(l, [this]() { return done || !queue.empty(); });
+			if (queue.empty()) return;
+			f = std::move(queue.front());
+			queue.pop_front();
+		}
+		bool const ok = write(*f);
+		std::lock_guard<std::mutex> l(lock);
+		failed |= !ok;
+		spare.push_back(std::move(f));
+	}
+}
+
+bool Writer::write(Frame const& f)
+{
+	// The integers of the frame: positions and velocities relative to the center
+	// of mass, quantized; masses and radii bit for bit.
+	int const n = f.n, w = width(f.columns);
+	std::vector<std::int64_t> words((size_t)n * w);
+	std::int64_t* out = words.data();
+	bool const fixed = options.precision == Precision::fixed;
+	auto relative = [&](std::vector<double> const& col, double origin, double quantum)
+		{
+			for (int i = 0; i < n; i++)
+				*out++ = fixed ? quantize(col[i] - origin, quantum) : bits((float)(col[i] - origin));
+		};
+	if (f.columns & position) relative(f.x, f.zcm.real(), options.quantum), relative(f.y, f.zcm.imag(), options.quantum);
+	if (f.columns & velocity) relative(f.vx, f.vcm.real(), options.vquantum), relative(f.vy, f.vcm.imag(), options.vquantum);
+	if (f.columns & mass) for (int i = 0; i < n; i++) *out++ = bits(f.m[i]);
+	if (f.columns & radius) for (int i = 0; i < n; i++) *out++ = bits(f.r[i]);
+
+	bool const key = since % std::max(1, options.keyframes) == 0 || previous.size() != words.size();
+	since = key ? 1 : since + 1;
+	bytes.clear();
+	for (size_t k = 0; k < words.size(); k++) put(bytes, key ? words[k] : words[k] - previous[k]);
+	previous.swap(words);
+
+	FrameHeader h{};
+	h.magic = magic_frame, h.key = key;
+	h.step = f.step, h.time = f.time;
+	h.zx = f.zcm.real(), h.zy = f.zcm.imag(), h.vx = f.vcm.real(), h.vy = f.vcm.imag();
+	h.n = n, h.bytes = bytes.size();
+	Mark const m{ (std::uint64_t)file.tellp(), f.step, f.time, (std::uint64_t)key };
+	file.write((char const*)&h, sizeof h);
+	if (!bytes.empty()) file.write(bytes.data(), bytes.size());
+	if (!file) return false;
+	index.push_back(m);
+	return true;
+}
+
+Reader::Reader(char const* path)
+	: file(path, std::ios::binary)
+{
+	FileHeader h;
+	if (!file.read((char*)&h, sizeof h) || std::memcmp(h.magic, magic, sizeof magic) || h.version != version) return;
+	options.columns = (int)h.columns, options.precision = (Precision)h.precision;
+	options.keyframes = (int)h.keyframes, options.quantum = h.quantum, options.vquantum = h.vquantum;
+
+	// The index at the end, if it's there.
+	file.seekg(0, std::ios::end);
+	std::uint64_t const size = (std::uint64_t)file.tellg();
+	FileFooter f;
+	if (size >= sizeof h + sizeof f)
+	{
+		file.seekg((std::streamoff)(size - sizeof f));
+		if (file.read((char*)&f, sizeof f) && !std::memcmp(f.magic, magic_index, sizeof magic_index)
+			&& f.offset + f.count * sizeof(Mark) + sizeof f == size)
+		{
+			index.resize((size_t)f.count);
+			file.seekg((std::streamoff)f.offset);
+			if (f.count && !file.read((char*)index.data(), (std::streamsize)(f.count * sizeof(Mark)))) index.clear();
+			else
+			{
+				ok = true;
+				return;
+			}
+		}
+	}
+
+	// Otherwise, find the frames one after another (up to the first one that's cut off).
+	file.clear();
+	std::uint64_t at = sizeof h;
+	FrameHeader fh;
+	while (at + sizeof fh <= size)
+	{
+		file.seekg((std::streamoff)at);
+		if (!file.read((char*)&fh, sizeof fh) || fh.magic != magic_frame || at + sizeof fh + fh.bytes > size) break;
+		index.push_back(Mark{ at, fh.step, fh.time, fh.key });
+		at += sizeof fh + fh.bytes;
+	}
+	file.clear();
+	ok = true;
+}
+
+bool Reader::read(int k, Frame& out)
+{
+	if (!ok || k < 0 || k >= frames()) return false;
+	// Start from the last key frame at or before k, unless the last frame read is nearer.
+	int start = k;
+	while (start > 0 && !index[start].key) start--;
+	if (last >= start && last < k) start = last + 1;
+	for (int j = start; j <= k; j++)
+		if (!decode(j, out))
+		{
+			last = -1;
+			return false;
+		}
+	return true;
+}
+
+bool Reader::decode(int k, Frame& out)
+{
+	FrameHeader h;
+	file.seekg((std::streamoff)index[k].offset);
+	if (!file.read((char*)&h, sizeof h) || h.magic != magic_frame || h.n < 0) return false;
+	bytes.resize((size_t)h.bytes);
+	if (h.bytes && !file.read(bytes.data(), (std::streamsize)h.bytes)) return false;
+
+	int const n = h.n, c = options.columns, w = width(c);
+	size_t const count = (size_t)n * w;
+	if (!h.key && words.size() != count) return false;
+	words.resize(count);
+	char const* p = bytes.data();
+	char const* const end = p + bytes.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		std::int64_t d;
+		if (!get(p, end, d)) return false;
+		words[i] = h.key ? d : words[i] + d;
+	}
+	last = k;
+
+	out.step = h.step, out.time = h.time, out.zcm = C(h.zx, h.zy), out.vcm = C(h.vx, h.vy);
+	out.n = n, out.columns = c;
+	std::int64_t const* in = words.data();
+	bool const fixed = options.precision == Precision::fixed;
+	auto relative = [&](std::vector<double>& col, double origin, double quantum, bool wanted)
+		{
+			col.clear();
+			if (!wanted) return;
+			col.resize(n);
+			for (int i = 0; i < n; i++, in++)
+				col[i] = origin + (fixed ? (double)*in * quantum : (double)unbits32(*in));
+		};
+	relative(out.x, h.zx, options.quantum, c & position), relative(out.y, h.zy, options.quantum, c & position);
+	relative(out.vx, h.vx, options.vquantum, c & velocity), relative(out.vy, h.vy, options.vquantum, c & velocity);
+	auto exact = [&](std::vector<double>& col, bool wanted)
+		{
+			col.clear();
+			if (!wanted) return;
+			col.resize(n);
+			for (int i = 0; i < n; i++) col[i] = unbits(*in++);
+		};
+	exact(out.m, c & mass), exact(out.r, c & radius);
+	return true;
+}
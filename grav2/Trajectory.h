@@ -0,0 +1,314 @@
+#pragma once
+#include "Include.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Dyn.h"
+
+/// <summary>
+/// Trajectories: the states of a simulation over time, streamed to a file
+/// for analysis or rendering afterward.
+///
+/// Each frame holds the chosen columns of the table. Positions and velocities
+/// are stored relative to the barycenter and the velocity of the center of mass
+/// (see `dyn::Dyn::barycenter`), quantized (to fixed point or to single precision),
+/// and encoded as the differences from the previous frame, which are small
+/// integers, in variable-length bytes. Every so often, a frame (a key frame)
+/// is stored whole, so that the reader can start decoding there.
+///
+/// An index of the frames is written at the end, so that any frame can be found
+/// at once; if it's missing (e.g., after a crash), the reader finds the frames
+/// one after another.
+/// </summary>
+namespace traj
+{
+	/// <summary>
+	/// Columns to store (a combination of flags).
+	/// </summary>
+	enum Columns
+	{
+		/// <summary>
+		/// Position (z).
+		/// </summary>
+		position = 1,
+		/// <summary>
+		/// Velocity (v).
+		/// </summary>
+		velocity = 2,
+		/// <summary>
+		/// Mass (m).
+		/// </summary>
+		mass = 4,
+		/// <summary>
+		/// Radius (r).
+		/// </summary>
+		radius = 8,
+		all = 15,
+	};
+
+	/// <summary>
+	/// Quantization of the positions and velocities.
+	/// </summary>
+	enum class Precision
+	{
+		/// <summary>
+		/// Fixed point: integer multiples of `Options::quantum` (the error is at most half of it).
+		/// </summary>
+		fixed,
+		/// <summary>
+		/// Single-precision floating point (about 7 significant digits).
+		/// </summary>
+		single,
+	};
+
+	/// <summary>
+	/// How to write a trajectory.
+	/// </summary>
+	struct Options
+	{
+		/// <summary>
+		/// Record every this many calls to `Writer::record`.
+		/// </summary>
+		int every{ 1 };
+
+		/// <summary>
+		/// If positive, record instead at the multiples of this much simulated time (T),
+		/// however long the steps are: each frame is interpolated to its exact time
+		/// within the step that passed it (see `dyn::Dyn::interpolate`).
+		/// </summary>
+		double interval{};
+
+		/// <summary>
+		/// Columns to store.
+		/// </summary>
+		int columns{ all };
+
+		/// <summary>
+		/// Quantization of the positions and velocities.
+		/// </summary>
+		Precision precision{ Precision::fixed };
+
+		/// <summary>
+		/// Steps of the fixed point (`Precision::fixed`) for the positions (L)
+		/// and for the velocities (L/T).
+		/// </summary>
+		double quantum{ 1e-6 }, vquantum{ 1e-6 };
+
+		/// <summary>
+		/// A key frame is stored every this many frames (and whenever the number
+		/// of particles changes). More means smaller files, but slower seeking.
+		/// </summary>
+		int keyframes{ 64 };
+
+		/// <summary>
+		/// Largest number of frames waiting to be written. If the disk falls this
+		/// far behind, frames are dropped (and counted) rather than waited for.
+		/// </summary>
+		int backlog{ 256 };
+	};
+
+	/// <summary>
+	/// One frame, decoded.
+	/// </summary>
+	struct Frame
+	{
+		/// <summary>
+		/// Number of steps and simulated time (T) at the time of the frame (see `dyn::Dyn::Stats`).
+		/// </summary>
+		long long step{};
+		double time{};
+
+		/// <summary>
+		/// Barycenter (L) and velocity of the center of mass (L/T).
+		/// </summary>
+		C zcm, vcm;
+
+		/// <summary>
+		/// Number of particles.
+		/// </summary>
+		int n{};
+
+		/// <summary>
+		/// Columns stored (see `Columns`); the others are empty.
+		/// </summary>
+		int columns{};
+
+		/// <summary>
+		/// Columns, indexed like the table (absolute, not relative to the barycenter).
+		/// </summary>
+		std::vector<double> x, y, vx, vy, m, r;
+	};
+
+	/// <summary>
+	/// Entry of the index of the frames (as stored).
+	/// </summary>
+	struct Mark
+	{
+		/// <summary>
+		/// Position of the frame in the file (bytes).
+		/// </summary>
+		std::uint64_t offset;
+		std::int64_t step;
+		double time;
+		/// <summary>
+		/// Whether it's a key frame (1) or not (0).
+		/// </summary>
+		std::uint64_t key;
+	};
+
+	/// <summary>
+	/// Append-only writer. The frames are copied on the calling thread, and
+	/// encoded and written on a thread of its own, so that `record` never waits for the disk.
+	/// </summary>
+	class Writer
+	{
+	public:
+		/// <summary>
+		/// Create (or replace) the file at `path`, and start the thread.
+		/// </summary>
+		Writer(char const* path, Options const& options = Options());
+
+		/// <summary>
+		/// Write what's left, and the index, and stop the thread.
+		/// </summary>
+		~Writer();
+
+		Writer(Writer const&) = delete;
+		Writer& operator=(Writer const&) = delete;
+
+		/// <summary>
+		/// Decide whether the file could be opened and nothing has failed since.
+		/// </summary>
+		bool good() const;
+
+		/// <summary>
+		/// Record the state of the simulation, if it's time to (see `Options::every`
+		/// and `Options::interval`). Call it after every step.
+		/// </summary>
+		/// <returns>Whether a frame was recorded (not dropped nor skipped)</returns>
+		bool record(dyn::Dyn const& dyn);
+
+		/// <summary>
+		/// Count the frames recorded, and those dropped because the disk was behind.
+		/// </summary>
+		long long recorded() const { return frames; }
+		long long dropped() const;
+
+	private:
+		Options const options;
+
+		/// <summary>
+		/// Calls to `record`; frames recorded.
+		/// </summary>
+		long long calls{}, frames{};
+
+		/// <summary>
+		/// Number of the next frame time (`Options::interval`).
+		/// </summary>
+		long long next{};
+
+		std::ofstream file;
+
+		/// <summary>
+		/// Frames waiting to be written, and frames to reuse (to save allocations).
+		/// </summary>
+		std::deque<std::unique_ptr<Frame>> queue, spare;
+
+		/// <summary>
+		/// Guards `queue`, `spare`, `done`, `failed`, `lost`.
+		/// </summary>
+		mutable std::mutex lock;
+		std::condition_variable wake;
+		bool done{}, failed{};
+		long long lost{};
+
+		/// <summary>
+		/// (Thread's own.) The previous frame as it was encoded (integers, before
+		/// the differences), the frames since the last key frame, and the index.
+		/// </summary>
+		std::vector<std::int64_t> previous;
+		int since{};
+		std::vector<char> bytes;
+
+		std::vector<Mark> index;
+
+		std::thread thread;
+
+		/// <summary>
+		/// Copy the state of the simulation at the time `t` (T) within the last step
+		/// into a frame, and queue it.
+		/// </summary>
+		bool capture(dyn::Dyn const& dyn, double t);
+
+		/// <summary>
+		/// Encode and write the frames as they come.
+		/// </summary>
+		void run();
+
+		/// <summary>
+		/// Encode and write a frame.
+		/// </summary>
+		bool write(Frame const& f);
+	};
+
+	/// <summary>
+	/// Reader of files written by `Writer`.
+	/// </summary>
+	class Reader
+	{
+	public:
+		/// <summary>
+		/// Open the file at `path` and read (or rebuild) the index.
+		/// </summary>
+		explicit Reader(char const* path);
+
+		/// <summary>
+		/// Decide whether the file could be opened and is a trajectory.
+		/// </summary>
+		bool good() const { return ok; }
+
+		/// <summary>
+		/// Count the frames.
+		/// </summary>
+		int frames() const { return (int)index.size(); }
+
+		/// <summary>
+		/// Recall the number of steps and the simulated time (T) of the frame `k`,
+		/// without reading it.
+		/// </summary>
+		long long step(int k) const { return index[k].step; }
+		double time(int k) const { return index[k].time; }
+
+		/// <summary>
+		/// Read the frame `k` (0 &lt;= k &lt; `frames()`), decoding from the nearest
+		/// key frame before it (or from the last frame read, if that's nearer).
+		/// </summary>
+		/// <returns>Whether it was read</returns>
+		bool read(int k, Frame& out);
+
+	private:
+		std::ifstream file;
+		bool ok{};
+		Options options;
+
+		std::vector<Mark> index;
+
+		/// <summary>
+		/// The last frame decoded (its index, or -1), as integers.
+		/// </summary>
+		int last{ -1 };
+		std::vector<std::int64_t> words;
+		std::vector<char> bytes;
+
+		/// <summary>
+		/// Decode the frame `k` on top of `words`.
+		/// </summary>
+		bool decode(int k, Frame& out);
+	};
+}
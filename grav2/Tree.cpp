@@ -0,0 +1,125 @@
+#include "Tree.h"
+#include <algorithm>
+
+using namespace tree;
+
+void Tree::build()
+{
+	nodes.clear();
+	where.assign(bodies.size(), -1);
+	if (bodies.empty()) return;
+
+	// Bounding square of all bodies.
+	double lx = bodies[0].z.real(), hx = lx, ly = bodies[0].z.imag(), hy = ly;
+	for (auto const& b : bodies)
+	{
+		lx = std::min(lx, b.z.real()), hx = std::max(hx, b.z.real());
+		ly = std::min(ly, b.z.imag()), hy = std::max(hy, b.z.imag());
+	}
+	// (Slightly enlarged so that no body sits exactly on the far edges.)
+	double half = std::max(hx - lx, hy - ly) / 2 * (1 + 1e-9) + 1e-300;
+
+	Node root;
+	root.begin = 0, root.end = (int)bodies.size();
+	nodes.push_back(root);
+	split(0, C((lx + hx) / 2, (ly + hy) / 2), half, 0);
+
+	for (int b = (int)bodies.size() - 1; b >= 0; b--)
+		where[bodies[b].i] = b;
+}
+
+void Tree::split(int k, C const& center, double half, int depth)
+{
+	int const begin = nodes[k].begin, end = nodes[k].end;
+
+	if (end - begin > leaf_size && depth < max_depth)
+	{
+		// Partition into the quadrants: first by the imaginary part
+		// (lower, upper), then each half by the real part (left, right).
+		auto b0 = bodies.begin() + begin, b4 = bodies.begin() + end;
+		auto lower = [&](Body const& b) { return b.z.imag() < center.imag(); };
+		auto left = [&](Body const& b) { return b.z.real() < center.real(); };
+		auto b2 = std::partition(b0, b4, lower);
+		auto b1 = std::partition(b0, b2, left);
+		auto b3 = std::partition(b2, b4, left);
+		int const cut[5] = {
+			begin, (int)(b1 - bodies.begin()), (int)(b2 - bodies.begin()),
+			(int)(b3 - bodies.begin()), end,
+		};
+		// Quadrant offsets, in the same order as the partitions above.
+		C const off[4] = { C(-.5, -.5), C(.5, -.5), C(-.5, .5), C(.5, .5) };
+
+		int const child = (int)nodes.size();
+		nodes[k].child = child;
+		for (int c = 0; c < 4; c++)
+		{
+			Node nd;
+			nd.begin = cut[c], nd.end = cut[c + 1];
+			nodes.push_back(nd);
+		}
+		for (int c = 0; c < 4; c++)
+			if (cut[c + 1] > cut[c])
+				split(child + c, center + off[c] * half, half / 2, depth + 1);
+
+		// Combine the moments of the children (parallel-axis theorem).
+		Node nd = nodes[k];
+		for (int c = 0; c < 4; c++)
+		{
+			Node const& ch = nodes[child + c];
+			nd.m += ch.m, nd.com += ch.m * ch.com;
+		}
+		nd.com /= nd.m;
+		for (int c = 0; c < 4; c++)
+		{
+			Node const& ch = nodes[child + c];
+			if (ch.end == ch.begin) continue;
+			C const d = ch.com - nd.com;
+			nd.q20 += ch.q20 + ch.m * d * d;
+			nd.q11 += ch.q11 + ch.m * std::norm(d);
+			nd.bmax = std::max(nd.bmax, abs(d) + ch.bmax);
+			nd.rmax = std::max(nd.rmax, ch.rmax);
+		}
+		nodes[k] = nd;
+		return;
+	}
+
+	// Leaf: compute the moments directly.
+	Node nd = nodes[k];
+	for (int b = begin; b < end; b++)
+		nd.m += bodies[b].m, nd.com += bodies[b].m * bodies[b].z;
+	nd.com /= nd.m;
+	for (int b = begin; b < end; b++)
+	{
+		C const w = bodies[b].z - nd.com;
+		nd.q20 += bodies[b].m * w * w;
+		nd.q11 += bodies[b].m * std::norm(w);
+		nd.bmax = std::max(nd.bmax, abs(w));
+		nd.rmax = std::max(nd.rmax, bodies[b].r);
+	}
+	nodes[k] = nd;
+}
+
+C Tree::far(Node const& nd, C const& z) const
+{
+	// See the namespace documentation for the derivation.
+	C const s = z - nd.com;
+	double const s2 = std::norm(s), s1 = sqrt(s2);
+	double const i3 = 1 / (s1 * s2), i5 = i3 / s2, i7 = i5 / s2;
+	C const a = nd.m * i3 * s
+		+ .75 * nd.q11 * i5 * s
+		+ .375 * i5 * nd.q20 * conj(s)
+		+ 1.875 * i7 * conj(nd.q20) * s * s * s;
+	return -G * a;
+}
+
+double Tree::well(Node const& nd, C const& z) const
+{
+	// The potential of the same expansion as in `far`.
+	C const s = z - nd.com;
+	double const s2 = std::norm(s), s1 = sqrt(s2);
+	double const i1 = 1 / s1, i3 = i1 / s2, i5 = i3 / s2;
+	double const u = nd.m * i1
+		+ .25 * nd.q11 * i3
+		+ .75 * i5 * (nd.q20 * conj(s) * conj(s)).real();
+	return -G * u;
+}
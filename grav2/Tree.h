@@ -0,0 +1,245 @@
+#pragma once
+#include "Include.h"
+#include <vector>
+
+/// <summary>
+/// Barnes-Hut quadtree for the approximation of the long-range
+/// (inverse-square) gravitational field.
+///
+/// The plane is recursively divided into quadrants until each leaf holds
+/// only a few bodies. Every node summarizes its bodies by the total mass,
+/// the center of mass, and the (complex) second moments about the center of mass.
+/// A distant node is then treated as a single body with a quadrupole
+/// correction, while a near node is opened and, eventually, the bodies
+/// in its leaves are handed back to the caller one at a time (so that
+/// the close-range behavior, such as the lune integral, is not lost).
+///
+/// Derivation of the quadrupole field. In the plane, the distance
+/// between z and w can be expanded in the complex powers of w and conj(w):
+///
+///     1/|z - w| = sum over j, k of a(j) a(k) w^j conj(w)^k / (z^j conj(z)^k |z|),
+///
+/// where a(j) = (2j choose j) / 4^j. Truncate it at j + k = 2. The "moments"
+/// are M = sum m, M20 = sum m w^2, and M11 = sum m |w|^2 about the center of mass
+/// (so that M10 vanishes). The acceleration is the gradient of the potential,
+/// which in complex notation is 2 d/d(conj z).
+/// </summary>
+namespace tree
+{
+	/// <summary>
+	/// A body (particle) as seen by the tree.
+	/// </summary>
+	struct Body
+	{
+		/// <summary>
+		/// Position (L).
+		/// </summary>
+		C z;
+		/// <summary>
+		/// Mass (M), radius (L).
+		/// </summary>
+		double m{}, r{};
+		/// <summary>
+		/// Index of the particle in the originating table.
+		/// </summary>
+		int i{};
+	};
+
+	/// <summary>
+	/// A square cell in the tree.
+	/// </summary>
+	struct Node
+	{
+		/// <summary>
+		/// Center of mass (L).
+		/// </summary>
+		C com;
+		/// <summary>
+		/// Second moment sum m (w - com)^2 (M L L).
+		/// </summary>
+		C q20;
+		/// <summary>
+		/// Total mass (M); second moment sum m |w - com|^2 (M L L).
+		/// </summary>
+		double m{}, q11{};
+		/// <summary>
+		/// Largest distance between the center of mass and the center of any
+		/// disk in the cell (L); largest radius of any disk in the cell (L).
+		/// </summary>
+		double bmax{}, rmax{};
+		/// <summary>
+		/// Range of bodies [begin, end) in the (reordered) `bodies`.
+		/// </summary>
+		int begin{}, end{};
+		/// <summary>
+		/// Index of the first child (the four children are contiguous),
+		/// or -1 if this is a leaf.
+		/// </summary>
+		int child{ -1 };
+	};
+
+	/// <summary>
+	/// Barnes-Hut quadtree.
+	/// </summary>
+	class Tree
+	{
+	public:
+		/// <summary>
+		/// Bodies, to be filled in before `build`. Reordered by `build` so that
+		/// each node holds a contiguous range.
+		/// </summary>
+		std::vector<Body> bodies;
+
+		/// <summary>
+		/// Opening angle. Smaller is more accurate and slower; 0 degenerates
+		/// to direct summation.
+		/// </summary>
+		double theta{ 0.5 };
+
+		/// <summary>
+		/// Gravitational constant (LLL/T/T/M).
+		/// </summary>
+		double G{ 1 };
+
+		/// <summary>
+		/// Largest number of bodies in a leaf.
+		/// </summary>
+		static constexpr int leaf_size = 8;
+
+		/// <summary>
+		/// Largest depth of the tree (bounds the work done on coincident bodies).
+		/// </summary>
+		static constexpr int max_depth = 48;
+
+		/// <summary>
+		/// Construct the tree (and the moments) over `bodies`.
+		/// </summary>
+		void build();
+
+		/// <summary>
+		/// Forget all bodies and nodes, but keep the storage.
+		/// </summary>
+		void clear() { bodies.clear(), nodes.clear(), where.clear(); }
+
+		/// <summary>
+		/// Decide whether the tree has been built (and is not empty).
+		/// </summary>
+		bool built() const { return !nodes.empty(); }
+
+		/// <summary>
+		/// Compute the acceleration felt at `z` by a disk of radius `r`
+		/// due to all distant nodes. For every body that is too close to
+		/// be summarized (its node was opened down to the leaf), call
+		/// `near(j)` with the original index `j` of the body instead.
+		/// The body whose original index is `self` is skipped.
+		/// </summary>
+		/// <typeparam name="Near">Callable as `void(int j)`</typeparam>
+		/// <param name="self">Original index of the particle to exclude</param>
+		/// <param name="z">Position of the particle (L)</param>
+		/// <param name="r">Radius of the particle (L)</param>
+		/// <param name="near">Process to handle individual nearby bodies</param>
+		/// <returns>Acceleration due to distant nodes (L/T/T)</returns>
+		template <class Near>
+		C field(int self, C const& z, double r, Near&& near) const;
+
+		/// <summary>
+		/// Like `field`, but compute the potential (per unit mass) at `z`
+		/// due to all distant nodes (-G sum m / distance, with the quadrupole correction).
+		/// </summary>
+		/// <returns>Potential due to distant nodes (LL/T/T)</returns>
+		template <class Near>
+		double potential(int self, C const& z, double r, Near&& near) const;
+
+		/// <summary>
+		/// Recall the nodes (the root is at index 0).
+		/// </summary>
+		std::vector<Node> const& cells() const { return nodes; }
+
+		/// <summary>
+		/// Recall the position in `bodies` of the body with the original index `i`.
+		/// </summary>
+		int position(int i) const { return where[i]; }
+
+	private:
+		/// <summary>
+		/// Nodes. The root is at index 0.
+		/// </summary>
+		std::vector<Node> nodes;
+
+		/// <summary>
+		/// Position of each body (by the original index) in `bodies`.
+		/// </summary>
+		std::vector<int> where;
+
+		/// <summary>
+		/// Subdivide the node at `k`, which spans the square of the given
+		/// center and half side length, and compute its moments.
+		/// </summary>
+		void split(int k, C const& center, double half, int depth);
+
+		/// <summary>
+		/// Acceleration at `z` due to the node `nd`, treated as a distant body
+		/// with a quadrupole correction.
+		/// </summary>
+		C far(Node const& nd, C const& z) const;
+
+		/// <summary>
+		/// Potential at `z` due to the node `nd`, like `far`.
+		/// </summary>
+		double well(Node const& nd, C const& z) const;
+
+		/// <summary>
+		/// Visit the nodes as seen from `z` (see `field`): call `distant(nd)` for
+		/// each node that is summarized, and `near(j)` for each body that is not.
+		/// </summary>
+		template <class Distant, class Near>
+		void walk(int self, C const& z, double r, Distant&& distant, Near&& near) const;
+	};
+
+	template <class Near>
+	C Tree::field(int self, C const& z, double r, Near&& near) const
+	{
+		C a;
+		walk(self, z, r, [&](Node const& nd) { a += far(nd, z); }, near);
+		return a;
+	}
+
+	template <class Near>
+	double Tree::potential(int self, C const& z, double r, Near&& near) const
+	{
+		double u{};
+		walk(self, z, r, [&](Node const& nd) { u += well(nd, z); }, near);
+		return u;
+	}
+
+	template <class Distant, class Near>
+	void Tree::walk(int self, C const& z, double r, Distant&& distant, Near&& near) const
+	{
+		if (nodes.empty()) return;
+		// Position of `self` in `bodies`, or -1 if not present.
+		int const me = 0 <= self && self < (int)where.size() ? where[self] : -1;
+		// Explicit stack of nodes to be visited. Each subdivision
+		// pushes at most four nodes, and the depth is bounded.
+		int stack[4 * max_depth], top = 0;
+		stack[top++] = 0;
+		while (top)
+		{
+			Node const& nd = nodes[stack[--top]];
+			bool const mine = nd.begin <= me && me < nd.end;
+			double const d = abs(z - nd.com);
+			// Multipole acceptance: small enough when seen from `z`, and
+			// no disk inside could possibly touch the disk at `z`.
+			if (!mine && nd.bmax < theta * d && d - nd.bmax > r + nd.rmax)
+				distant(nd);
+			else if (nd.child < 0)
+			{
+				for (int b = nd.begin; b < nd.end; b++)
+					if (b != me) near(bodies[b].i);
+			}
+			else
+				for (int c = 3; c >= 0; c--)
+					if (nodes[nd.child + c].end > nodes[nd.child + c].begin)
+						stack[top++] = nd.child + c;
+		}
+	}
+}